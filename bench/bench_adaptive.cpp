@@ -0,0 +1,125 @@
+// Benchmark: uniform grid vs. adaptive quadtree sampling (AdaptiveSampler.h). For every
+// analytic preset (x0/x1 slice, other variables at mid-range) the triangulated surface of
+// each sampler is compared against f at random points; errors are relative to the value
+// range of the uniform grid. Reports how many evaluations the adaptive sampler needs to
+// match the RMS error of the uniform grid.
+//
+//   fvt-bench-adaptive [-n N] [preset ...]     (default: N=129, all analytic presets)
+
+#include "AdaptiveSampler.h"
+#include "GridSampler.h"
+#include "ObjectiveFunction.h"
+#include "Presets.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Error
+{
+    double rms{0.0};
+    double max{0.0};
+};
+
+// Errors of `surface` (u, v in [0,1]) against f on random points of the slice.
+template <class Surface>
+Error measure(const ObjectiveFunction& f, const SliceSpec& spec, double range, Surface surface)
+{
+    std::mt19937_64 rng(777);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::vector<double> x = spec.fixed;
+    const size_t ax = static_cast<size_t>(spec.xAxis), ay = static_cast<size_t>(spec.yAxis);
+
+    const int samples = 20000;
+    Error e;
+    for(int k=0;k<samples;k++){
+        const double u = unit(rng), v = unit(rng);
+        x[ax] = spec.lower[ax] + (spec.upper[ax]-spec.lower[ax])*u;
+        x[ay] = spec.lower[ay] + (spec.upper[ay]-spec.lower[ay])*v;
+        const double d = std::fabs(surface(u, v) - displayValue(f.evaluate(x))) / range;
+        e.rms += d*d;
+        e.max = std::max(e.max, d);
+    }
+    e.rms = std::sqrt(e.rms / samples);
+    return e;
+}
+
+// The uniform mesh: tri1/tri2 of each cell, as SurfaceWidget triangulates it.
+double gridSurface(const HeightGrid& g, double u, double v)
+{
+    const int n = g.n;
+    const double a = u*(n-1), b = v*(n-1);
+    const int i = std::min(int(a), n-2), j = std::min(int(b), n-2);
+    const double s = a - i, t = b - j;
+    auto z = [&](int di, int dj){ return g.z[static_cast<size_t>(j+dj)*static_cast<size_t>(n) + static_cast<size_t>(i+di)]; };
+    if(s + t <= 1.0) return z(0,0) + s*(z(1,0)-z(0,0)) + t*(z(0,1)-z(0,0));
+    return z(1,1) + (1.0-s)*(z(0,1)-z(1,1)) + (1.0-t)*(z(1,0)-z(1,1));
+}
+
+void benchPreset(const Preset& p, int n)
+{
+    ObjectiveFunction f;
+    std::string err;
+    if(!f.setExpression(p.expr, p.dim, &err)){
+        std::fprintf(stderr, "%s: %s\n", p.name.c_str(), err.c_str());
+        return;
+    }
+
+    SliceSpec spec;
+    spec.dim = p.dim;
+    spec.n = n;
+    spec.lower.assign(static_cast<size_t>(p.dim), p.lo);
+    spec.upper.assign(static_cast<size_t>(p.dim), p.hi);
+    spec.fixed.assign(static_cast<size_t>(p.dim), 0.5*(p.lo + p.hi));
+
+    HeightGrid grid;
+    GridSampler(f, spec).sample(grid);
+    const double range = std::max(grid.zMax - grid.zMin, 1e-300);
+    const Error uniform = measure(f, spec, range, [&](double u, double v){ return gridSurface(grid, u, v); });
+    std::printf("%-18s uniform %6d evals  rms %.2e  max %.2e", p.name.c_str(), n*n, uniform.rms, uniform.max);
+
+    // Smallest budget (in steps of 25%) at which the adaptive surface is at least as
+    // accurate as the uniform grid in the RMS sense. The lattice is twice as fine as the
+    // grid, so sharp features can be resolved beyond it.
+    int depth = 1;
+    while((1 << depth) < n-1) depth++;
+    AdaptiveSampler sampler(f, spec, depth + 1);
+    Error e;
+    for(double budget = 256.0; budget <= 4.0*n*n; budget *= 1.25){
+        sampler.refine(static_cast<size_t>(budget), 0.0);
+        e = measure(f, spec, range, [&](double u, double v){ return sampler.interpolate(u, v); });
+        if(e.rms <= uniform.rms) break;
+    }
+    const double ratio = double(n)*double(n) / double(sampler.evaluations());
+    std::printf("  | adaptive %6zu evals  rms %.2e  max %.2e  (%.2fx %s)", sampler.evaluations(), e.rms, e.max,
+                ratio >= 1.0 ? ratio : 1.0/ratio, ratio >= 1.0 ? "fewer" : "more");
+    std::printf("\n");
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    int n = 129;
+    std::vector<Preset> presets;
+    for(int i=1;i<argc;i++){
+        const std::string a = argv[i];
+        if(a=="-n" && i+1<argc){ n = std::max(3, std::atoi(argv[++i])); continue; }
+        const Preset* p = findPreset(a);
+        if(!p || p->expr.empty()){
+            std::fprintf(stderr, "%s: not an analytic preset\n", argv[i]);
+            return 1;
+        }
+        presets.push_back(*p);
+    }
+    if(presets.empty())
+        for(const auto& p : builtinPresets()) if(!p.expr.empty()) presets.push_back(p);
+
+    for(const auto& p : presets) benchPreset(p, n);
+    return 0;
+}
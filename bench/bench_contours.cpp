@@ -0,0 +1,76 @@
+// Benchmark: marching-squares contour extraction (ContourExtractor.h). For every analytic
+// preset (x0/x1 slice, other variables at mid-range) the slice is sampled once and its
+// isolines are extracted repeatedly; reports the best time and the number of segments.
+//
+//   fvt-bench-contours [-n N] [-k LEVELS] [preset ...]   (default: N=401, 64 levels, all analytic presets)
+
+#include "ContourExtractor.h"
+#include "GridSampler.h"
+#include "ObjectiveFunction.h"
+#include "Presets.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace {
+
+void benchPreset(const Preset& p, int n, int levels)
+{
+    ObjectiveFunction f;
+    std::string err;
+    if(!f.setExpression(p.expr, p.dim, &err)){
+        std::fprintf(stderr, "%s: %s\n", p.name.c_str(), err.c_str());
+        return;
+    }
+
+    SliceSpec spec;
+    spec.dim = p.dim;
+    spec.n = n;
+    spec.lower.assign(static_cast<size_t>(p.dim), p.lo);
+    spec.upper.assign(static_cast<size_t>(p.dim), p.hi);
+    spec.fixed.assign(static_cast<size_t>(p.dim), 0.5*(p.lo + p.hi));
+
+    HeightGrid grid;
+    GridSampler(f, spec).sample(grid);
+    const std::vector<double> L = contourLevels(grid.zMin, grid.zMax, levels);
+
+    double best = 1e300;
+    size_t segments = 0;
+    for(int r=0;r<20;r++){
+        const auto t0 = std::chrono::steady_clock::now();
+        const ContourLines lines = extractContours(grid, L);
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        best = std::min(best, ms);
+        segments = lines.segments();
+    }
+    std::printf("%-18s %dx%d, %d levels: %7.3f ms  %8zu segments\n", p.name.c_str(), n, n, levels, best, segments);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    int n = 401, levels = 64;
+    std::vector<Preset> presets;
+    for(int i=1;i<argc;i++){
+        const std::string a = argv[i];
+        if(a=="-n" && i+1<argc){ n = std::max(2, std::atoi(argv[++i])); continue; }
+        if(a=="-k" && i+1<argc){ levels = std::max(1, std::atoi(argv[++i])); continue; }
+        const Preset* p = findPreset(a);
+        if(!p || p->expr.empty()){
+            std::fprintf(stderr, "%s: not an analytic preset\n", argv[i]);
+            return 1;
+        }
+        presets.push_back(*p);
+    }
+    if(presets.empty())
+        for(const auto& p : builtinPresets()) if(!p.expr.empty()) presets.push_back(p);
+
+    std::printf("%d threads\n", ThreadPool::global().concurrency());
+    for(const auto& p : presets) benchPreset(p, n, levels);
+    return 0;
+}
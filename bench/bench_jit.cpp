@@ -0,0 +1,136 @@
+// Benchmark: bytecode interpreter vs. native code (Jit.h) throughput for every analytic
+// preset, per point and batched, in million points per second.
+//
+//   fvt-bench-jit [preset ...]     (default: all analytic presets)
+
+#include "ObjectiveFunction.h"
+#include "Presets.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+volatile double g_sink = 0.0;
+
+struct Points
+{
+    std::vector<double> aos;   // point-major, dim values per point
+    std::vector<double> soa;   // variable-major
+    std::vector<ObjectiveFunction::Column> cols;
+    size_t count{0};
+};
+
+Points makePoints(const Preset& p, size_t count)
+{
+    std::mt19937_64 rng(12345);
+    std::uniform_real_distribution<double> u(p.lo, p.hi);
+    const size_t dim = static_cast<size_t>(p.dim);
+
+    Points pts;
+    pts.count = count;
+    pts.aos.resize(dim*count);
+    for(auto& v : pts.aos) v = u(rng);
+    pts.soa.resize(dim*count);
+    pts.cols.resize(dim);
+    for(size_t d=0;d<dim;d++){
+        for(size_t k=0;k<count;k++) pts.soa[d*count + k] = pts.aos[k*dim + d];
+        pts.cols[d] = {pts.soa.data() + d*count, 1};
+    }
+    return pts;
+}
+
+// Million points per second, best of a few runs of at least ~50 ms each.
+template <class Fn>
+double mpps(size_t pointsPerCall, Fn fn)
+{
+    double best = 0.0;
+    for(int run=0; run<3; run++){
+        size_t calls = 0;
+        const auto t0 = Clock::now();
+        double sec = 0.0;
+        do {
+            fn();
+            calls++;
+            sec = std::chrono::duration<double>(Clock::now() - t0).count();
+        } while(sec < 0.05);
+        best = std::fmax(best, double(calls*pointsPerCall) / sec * 1e-6);
+    }
+    return best;
+}
+
+bool benchPreset(const Preset& p)
+{
+    ObjectiveFunction f;
+    std::string err;
+    if(!f.setExpression(p.expr, p.dim, &err)){
+        std::fprintf(stderr, "%s: %s\n", p.name.c_str(), err.c_str());
+        return false;
+    }
+
+    const Points pts = makePoints(p, 4096);
+    const size_t dim = static_cast<size_t>(p.dim);
+    std::vector<double> out(pts.count);
+
+    auto scalar = [&]{
+        double acc = 0.0;
+        for(size_t k=0;k<pts.count;k++) acc += f.evaluate(pts.aos.data() + k*dim);
+        g_sink = acc;
+    };
+    auto batch = [&]{
+        f.evaluateBatch(pts.cols.data(), pts.count, out.data());
+        g_sink = out[0];
+    };
+
+    f.setNativeCodeEnabled(false);
+    const double interp = mpps(pts.count, scalar);
+    const double interpBatch = mpps(pts.count, batch);
+    std::vector<double> ref(pts.count);
+    for(size_t k=0;k<pts.count;k++) ref[k] = f.evaluate(pts.aos.data() + k*dim);
+
+    f.setNativeCodeEnabled(true);
+    if(!f.nativeCodeEnabled()){
+        std::printf("%-18s interpreter %8.2f Mpt/s  batch %8.2f Mpt/s  (no native code on this platform)\n",
+                    p.name.c_str(), interp, interpBatch);
+        return true;
+    }
+    const double jit = mpps(pts.count, scalar);
+    const double jitBatch = mpps(pts.count, batch);
+
+    size_t mismatches = 0;
+    for(size_t k=0;k<pts.count;k++){
+        const double v = f.evaluate(pts.aos.data() + k*dim);
+        if(std::memcmp(&v, &ref[k], sizeof v) != 0 && !(std::isnan(v) && std::isnan(ref[k]))) mismatches++;
+    }
+
+    std::printf("%-18s instrs=%-4d interpreter %8.2f Mpt/s  jit %8.2f Mpt/s (%5.2fx)  batch: interpreter %8.2f  jit %8.2f Mpt/s (%5.2fx)  mismatches=%zu\n",
+                p.name.c_str(), f.programSize(), interp, jit, jit/interp, interpBatch, jitBatch, jitBatch/interpBatch, mismatches);
+    return mismatches == 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    std::vector<Preset> presets;
+    for(int i=1;i<argc;i++){
+        const Preset* p = findPreset(argv[i]);
+        if(!p || p->expr.empty()){
+            std::fprintf(stderr, "%s: not an analytic preset\n", argv[i]);
+            return 1;
+        }
+        presets.push_back(*p);
+    }
+    if(presets.empty())
+        for(const auto& p : builtinPresets()) if(!p.expr.empty()) presets.push_back(p);
+
+    bool ok = true;
+    for(const auto& p : presets) ok = benchPreset(p) && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,139 @@
+// Micro-benchmark: compiled bytecode evaluator (per point and batched) vs. the original
+// token-walking evaluator, plus a slice-specialised 256×256 grid (GridSampler, one thread).
+//
+//   fvt-bench-objective [preset ...]     (default: weierstrass hartmann6)
+
+#include "GridSampler.h"
+#include "ObjectiveFunction.h"
+#include "Presets.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Keeps results observable so the evaluation loops are not optimised away.
+volatile double g_sink = 0.0;
+
+std::vector<std::vector<double>> makePoints(const Preset& p, int count)
+{
+    std::mt19937_64 rng(12345);
+    std::uniform_real_distribution<double> u(p.lo, p.hi);
+    std::vector<std::vector<double>> pts(static_cast<size_t>(count), std::vector<double>(static_cast<size_t>(p.dim)));
+    for(auto& x : pts) for(auto& v : x) v = u(rng);
+    return pts;
+}
+
+template <class Fn>
+double nsPerEval(const std::vector<std::vector<double>>& pts, int reps, Fn fn)
+{
+    double acc = 0.0;
+    const auto t0 = Clock::now();
+    for(int r=0;r<reps;r++) for(const auto& x : pts) acc += fn(x);
+    const auto t1 = Clock::now();
+    g_sink = acc;
+    const double ns = std::chrono::duration<double, std::nano>(t1 - t0).count();
+    return ns / (double(reps) * double(pts.size()));
+}
+
+// Batched evaluation over the same points, laid out as one column per variable.
+double nsPerEvalBatch(const ObjectiveFunction& f, const std::vector<std::vector<double>>& pts, int reps)
+{
+    const size_t n = pts.size();
+    const int dim = f.dimension();
+    std::vector<double> soa(static_cast<size_t>(dim) * n);
+    std::vector<ObjectiveFunction::Column> cols(static_cast<size_t>(dim));
+    for(int d=0;d<dim;d++){
+        for(size_t k=0;k<n;k++) soa[static_cast<size_t>(d)*n + k] = pts[k][static_cast<size_t>(d)];
+        cols[static_cast<size_t>(d)] = {soa.data() + static_cast<size_t>(d)*n, 1};
+    }
+    std::vector<double> out(n);
+
+    double acc = 0.0;
+    const auto t0 = Clock::now();
+    for(int r=0;r<reps;r++){
+        f.evaluateBatch(cols.data(), n, out.data());
+        acc += out[static_cast<size_t>(r) % n];
+    }
+    const auto t1 = Clock::now();
+    g_sink = acc;
+    const double ns = std::chrono::duration<double, std::nano>(t1 - t0).count();
+    return ns / (double(reps) * double(n));
+}
+
+// Slice through the middle of the domain over the first and last variable.
+double nsPerPointSlice(const ObjectiveFunction& f, const Preset& p, int& mainSize)
+{
+    SliceSpec spec;
+    spec.dim = p.dim;
+    spec.xAxis = 0;
+    spec.yAxis = p.dim - 1;
+    spec.n = 256;
+    spec.lower.assign(static_cast<size_t>(p.dim), p.lo);
+    spec.upper.assign(static_cast<size_t>(p.dim), p.hi);
+    spec.fixed.assign(static_cast<size_t>(p.dim), 0.5*(p.lo + p.hi));
+
+    std::vector<double> z(static_cast<size_t>(spec.n) * static_cast<size_t>(spec.n));
+    const auto t0 = Clock::now();
+    const GridSampler sampler(f, spec);
+    sampler.sampleRows(0, spec.n, z.data());
+    const auto t1 = Clock::now();
+    g_sink = z[z.size()/2];
+    mainSize = sampler.plan().main.programSize();
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / double(z.size());
+}
+
+bool benchPreset(const std::string& name)
+{
+    const Preset* p = findPreset(name);
+    if(!p || p->expr.empty()){
+        std::fprintf(stderr, "%s: not an analytic preset\n", name.c_str());
+        return false;
+    }
+
+    ObjectiveFunction f;
+    std::string err;
+    if(!f.setExpression(p->expr, p->dim, &err)){
+        std::fprintf(stderr, "%s: %s\n", name.c_str(), err.c_str());
+        return false;
+    }
+
+    const auto pts = makePoints(*p, 4096);
+
+    double maxDiff = 0.0;
+    for(const auto& x : pts){
+        const double a = f.evaluateReference(x);
+        const double b = f.evaluate(x);
+        if(std::isfinite(a) || std::isfinite(b)) maxDiff = std::fmax(maxDiff, std::fabs(a - b));
+    }
+
+    const int reps = 20;
+    const double nsRef = nsPerEval(pts, reps, [&](const std::vector<double>& x){ return f.evaluateReference(x); });
+    const double nsNew = nsPerEval(pts, reps, [&](const std::vector<double>& x){ return f.evaluate(x); });
+    const double nsBatch = nsPerEvalBatch(f, pts, reps);
+    int sliceSize = 0;
+    const double nsSlice = nsPerPointSlice(f, *p, sliceSize);
+
+    std::printf("%-12s dim=%d  instrs=%4d->%-4d shared=%-3d regs=%-2d stack=%-3d  reference %9.1f ns/eval  bytecode %9.1f ns/eval (%5.2fx)  batch %9.1f ns/eval (%5.2fx)  slice %9.1f ns/pt (%d instrs)  max|diff|=%g\n",
+                name.c_str(), p->dim, f.unoptimizedSize(), f.programSize(), f.sharedSubexpressions(), f.registerCount(), f.maxStackDepth(),
+                nsRef, nsNew, nsRef / nsNew, nsBatch, nsRef / nsBatch, nsSlice, sliceSize, maxDiff);
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> names;
+    for(int i=1;i<argc;i++) names.emplace_back(argv[i]);
+    if(names.empty()) names = {"weierstrass", "hartmann6"};
+
+    bool ok = true;
+    for(const auto& n : names) ok = benchPreset(n) && ok;
+    return ok ? 0 : 1;
+}
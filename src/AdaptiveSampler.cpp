@@ -0,0 +1,213 @@
+#include "AdaptiveSampler.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+AdaptiveSampler::AdaptiveSampler(const ObjectiveFunction& obj, const SliceSpec& spec, int maxDepth, int baseDepth)
+    : obj_(obj), spec_(spec), valid_(obj.dimension()==spec.dim),
+      lo_(std::numeric_limits<double>::infinity()), hi_(-std::numeric_limits<double>::infinity())
+{
+    maxDepth = std::clamp(maxDepth, 1, 15);
+    baseDepth = std::clamp(baseDepth, 0, maxDepth);
+    lattice_ = 1 << maxDepth;
+    if(static_cast<int>(spec_.fixed.size()) != spec_.dim) spec_.fixed.assign(static_cast<size_t>(spec_.dim), 0.0);
+    x_ = spec_.fixed;
+
+    value(0, 0); value(lattice_, 0); value(0, lattice_); value(lattice_, lattice_);
+    addLeaf(0, 0, lattice_);
+
+    // Uniform base level: features smaller than a base cell would otherwise go unnoticed.
+    for(int d=0; d<baseDepth; d++){
+        const size_t count = cells_.size();
+        for(size_t c=0;c<count;c++)
+            if(cells_[c].child < 0) split(static_cast<int>(c));
+    }
+}
+
+double AdaptiveSampler::value(int i, int j)
+{
+    auto it = values_.find(key(i, j));
+    if(it != values_.end()) return it->second;
+
+    const size_t ax = static_cast<size_t>(spec_.xAxis), ay = static_cast<size_t>(spec_.yAxis);
+    double z = 0.0;
+    if(valid_){
+        x_[ax] = spec_.lower[ax] + (spec_.upper[ax]-spec_.lower[ax]) * (double(i)/lattice_);
+        x_[ay] = spec_.lower[ay] + (spec_.upper[ay]-spec_.lower[ay]) * (double(j)/lattice_);
+        z = displayValue(obj_.evaluate(x_.data()));
+    }
+    values_.emplace(key(i, j), z);
+    lo_ = std::min(lo_, z);
+    hi_ = std::max(hi_, z);
+    return z;
+}
+
+void AdaptiveSampler::addLeaf(int i, int j, int size)
+{
+    cells_.push_back({i, j, size});
+    if(size < 2) return;
+
+    // 3×3 stencil: the corners plus the centre and edge midpoints, which are evaluated now and
+    // become vertices of the leaf's fan (and corners of its children if it is split). The
+    // largest second difference D along the stencil rows, columns or diagonals estimates the
+    // error of linear interpolation at spacing size/2 as D/8.
+    const int h = size/2;
+    double f[3][3];
+    for(int a=0;a<3;a++)
+        for(int b=0;b<3;b++)
+            f[a][b] = value(i + a*h, j + b*h);
+    double d = std::fabs(f[0][0] - f[2][0] - f[0][2] + f[2][2]) / 4.0;
+    for(int k=0;k<3;k++){
+        d = std::max(d, std::fabs(f[0][k] - 2.0*f[1][k] + f[2][k]));
+        d = std::max(d, std::fabs(f[k][0] - 2.0*f[k][1] + f[k][2]));
+    }
+    queue_.emplace(d / 8.0, static_cast<int>(cells_.size()) - 1);
+}
+
+int AdaptiveSampler::leafAt(double a, double b) const
+{
+    int c = 0;
+    while(cells_[static_cast<size_t>(c)].child >= 0){
+        const Cell& cell = cells_[static_cast<size_t>(c)];
+        const double h = 0.5*cell.size;
+        c = cell.child + (a > cell.i + h ? 1 : 0) + (b > cell.j + h ? 2 : 0);
+    }
+    return c;
+}
+
+void AdaptiveSampler::split(int c)
+{
+    const int i = cells_[static_cast<size_t>(c)].i;
+    const int j = cells_[static_cast<size_t>(c)].j;
+    const int s = cells_[static_cast<size_t>(c)].size;
+    const int h = s/2;
+
+    // Balance first: an edge neighbour that is coarser than this cell is split before it,
+    // which may cascade to coarser cells but never back to this one.
+    const double ci = i + h, cj = j + h;
+    const double probes[4][2] = {{i-0.5, cj}, {i+s+0.5, cj}, {ci, j-0.5}, {ci, j+s+0.5}};
+    for(const auto& p : probes){
+        if(p[0] < 0.0 || p[1] < 0.0 || p[0] > lattice_ || p[1] > lattice_) continue;
+        const int n = leafAt(p[0], p[1]);
+        if(cells_[static_cast<size_t>(n)].size > s) split(n);
+    }
+
+    cells_[static_cast<size_t>(c)].child = static_cast<int>(cells_.size());
+    addLeaf(i, j, h);
+    addLeaf(i+h, j, h);
+    addLeaf(i, j+h, h);
+    addLeaf(i+h, j+h, h);
+}
+
+bool AdaptiveSampler::refine(std::size_t budget, double tolerance, const std::atomic<bool>* cancel)
+{
+    while(!queue_.empty()){
+        if(cancel && cancel->load(std::memory_order_relaxed)) return false;
+        const auto [err, c] = queue_.top();
+        if(cells_[static_cast<size_t>(c)].child >= 0){ queue_.pop(); continue; }   // split while balancing
+
+        // A split costs at most 16 evaluations: the centres and edge midpoints of the children.
+        if(values_.size() + 16 > budget || err <= tolerance*(hi_ - lo_)) break;
+        queue_.pop();
+        split(c);
+    }
+    return true;
+}
+
+std::size_t AdaptiveSampler::leafCount() const
+{
+    return static_cast<std::size_t>(std::count_if(cells_.begin(), cells_.end(), [](const Cell& c){ return c.child < 0; }));
+}
+
+void AdaptiveSampler::boundary(const Cell& c, std::vector<std::pair<int,int>>& loop) const
+{
+    // Every evaluated point on an edge is a vertex of the leaves on both sides. The points
+    // are nested dyadically (a quarter point exists only if the midpoint does), so each
+    // edge is collected by bisection.
+    loop.clear();
+    auto edge = [&](auto&& self, int i0, int j0, int i1, int j1) -> void {
+        const int im = (i0+i1)/2, jm = (j0+j1)/2;
+        if(std::abs(i1-i0) + std::abs(j1-j0) < 2 || !has(im, jm)) return;
+        self(self, i0, j0, im, jm);
+        loop.emplace_back(im, jm);
+        self(self, im, jm, i1, j1);
+    };
+    const int i = c.i, j = c.j, s = c.size;
+    const int corners[4][2] = {{i, j}, {i+s, j}, {i+s, j+s}, {i, j+s}};
+    for(int k=0;k<4;k++){
+        loop.emplace_back(corners[k][0], corners[k][1]);
+        edge(edge, corners[k][0], corners[k][1], corners[(k+1)%4][0], corners[(k+1)%4][1]);
+    }
+}
+
+AdaptiveMesh AdaptiveSampler::triangulate() const
+{
+    AdaptiveMesh mesh;
+    std::unordered_map<std::uint64_t, unsigned int> index;
+    index.reserve(values_.size());
+    auto vertex = [&](int i, int j) -> unsigned int {
+        const auto [it, inserted] = index.emplace(key(i, j), static_cast<unsigned int>(mesh.z.size()));
+        if(inserted){
+            mesh.u.push_back(double(i)/lattice_);
+            mesh.v.push_back(double(j)/lattice_);
+            mesh.z.push_back(valueAt(i, j));
+        }
+        return it->second;
+    };
+    auto triangle = [&](unsigned int a, unsigned int b, unsigned int c){
+        mesh.indices.push_back(a); mesh.indices.push_back(b); mesh.indices.push_back(c);
+    };
+
+    // Triangles are clockwise in (i, j), like tri1/tri2 of the grid mesh.
+    std::vector<std::pair<int,int>> loop;
+    for(const Cell& c : cells_){
+        if(c.child >= 0) continue;
+        if(c.size == 1){
+            const unsigned int i0 = vertex(c.i, c.j), i1 = vertex(c.i+1, c.j);
+            const unsigned int i2 = vertex(c.i, c.j+1), i3 = vertex(c.i+1, c.j+1);
+            triangle(i0, i2, i1);
+            triangle(i1, i2, i3);
+            continue;
+        }
+        boundary(c, loop);
+        const unsigned int centre = vertex(c.i + c.size/2, c.j + c.size/2);
+        for(size_t m=0;m<loop.size();m++){
+            const auto& a = loop[m];
+            const auto& b = loop[(m+1) % loop.size()];
+            triangle(centre, vertex(b.first, b.second), vertex(a.first, a.second));
+        }
+    }
+    return mesh;
+}
+
+double AdaptiveSampler::interpolate(double u, double v) const
+{
+    const double a = std::clamp(u, 0.0, 1.0)*lattice_;
+    const double b = std::clamp(v, 0.0, 1.0)*lattice_;
+    const Cell& c = cells_[static_cast<size_t>(leafAt(a, b))];
+
+    // Barycentric interpolation on triangle (p, q, r); false if (a, b) is outside it.
+    auto onTriangle = [&](std::pair<int,int> p, std::pair<int,int> q, std::pair<int,int> r, double& z){
+        const double d = double(q.second - r.second)*(p.first - r.first) + double(r.first - q.first)*(p.second - r.second);
+        const double l0 = (double(q.second - r.second)*(a - r.first) + double(r.first - q.first)*(b - r.second)) / d;
+        const double l1 = (double(r.second - p.second)*(a - r.first) + double(p.first - r.first)*(b - r.second)) / d;
+        const double l2 = 1.0 - l0 - l1;
+        const double eps = -1e-9;
+        if(l0 < eps || l1 < eps || l2 < eps) return false;
+        z = l0*valueAt(p.first, p.second) + l1*valueAt(q.first, q.second) + l2*valueAt(r.first, r.second);
+        return true;
+    };
+
+    double z = 0.0;
+    if(c.size == 1){
+        const std::pair<int,int> p0{c.i, c.j}, p1{c.i+1, c.j}, p2{c.i, c.j+1}, p3{c.i+1, c.j+1};
+        if(onTriangle(p0, p2, p1, z) || onTriangle(p1, p2, p3, z)) return z;
+        return valueAt(c.i, c.j);
+    }
+    std::vector<std::pair<int,int>> loop;
+    boundary(c, loop);
+    const std::pair<int,int> centre{c.i + c.size/2, c.j + c.size/2};
+    for(size_t m=0;m<loop.size();m++)
+        if(onTriangle(centre, loop[(m+1) % loop.size()], loop[m], z)) return z;
+    return valueAt(centre.first, centre.second);
+}
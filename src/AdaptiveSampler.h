@@ -0,0 +1,76 @@
+#pragma once
+#include "GridSampler.h"
+#include "ObjectiveFunction.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <queue>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Triangulated adaptive sample: vertex k is at (u[k], v[k]) in [0,1]² of the slice domain
+// with height z[k]; indices holds triangles with the winding of the uniform grid mesh.
+struct AdaptiveMesh
+{
+    std::vector<double> u, v, z;
+    std::vector<unsigned int> indices;
+};
+
+// Error-driven quadtree sampling of a slice (SliceSpec::n is not used). Cells live on a
+// (2^maxDepth + 1)² lattice; every cell is first split down to baseDepth, then the leaf with
+// the largest interpolation error estimate (from the second differences of its 3×3 stencil)
+// is split next, until the evaluation budget is spent or no leaf exceeds tolerance × the
+// sampled value range.
+//
+// The tree is kept 2:1 balanced (edge neighbours differ by at most one level). triangulate()
+// fans every leaf from its centre through all evaluated points on its boundary, so adjacent
+// leaves share every edge vertex and the mesh is crack-free.
+class AdaptiveSampler
+{
+public:
+    AdaptiveSampler(const ObjectiveFunction& obj, const SliceSpec& spec, int maxDepth, int baseDepth = 3);
+
+    // Continues refining until `budget` evaluations have been made in total (a split that
+    // balancing forces may overshoot slightly), no leaf exceeds the tolerance, or every
+    // candidate is at maxDepth. Can be called again with a larger budget. `cancel` is polled
+    // between splits; returns false if it was raised.
+    bool refine(std::size_t budget, double tolerance, const std::atomic<bool>* cancel = nullptr);
+
+    std::size_t evaluations() const { return values_.size(); }
+    std::size_t leafCount() const;
+    double lo() const { return lo_; }
+    double hi() const { return hi_; }
+
+    AdaptiveMesh triangulate() const;
+
+    // Height of the triangulated surface at (u, v) in [0,1]².
+    double interpolate(double u, double v) const;
+
+private:
+    struct Cell {
+        int i, j, size;   // lower corner and side on the lattice
+        int child{-1};    // first of four children (x-major, then y), -1 for a leaf
+    };
+
+    std::uint64_t key(int i, int j) const { return std::uint64_t(i)*std::uint64_t(lattice_+1) + std::uint64_t(j); }
+    double value(int i, int j);
+    double valueAt(int i, int j) const { return values_.at(key(i, j)); }
+    bool has(int i, int j) const { return values_.count(key(i, j)) != 0; }
+
+    void split(int c);
+    void addLeaf(int i, int j, int size);
+    int leafAt(double a, double b) const;   // lattice coordinates
+    // Corners and edge points of a leaf, counter-clockwise from its lower-left corner.
+    void boundary(const Cell& c, std::vector<std::pair<int,int>>& loop) const;
+
+    ObjectiveFunction obj_;
+    SliceSpec spec_;
+    bool valid_{false};
+    int lattice_{1};
+    std::vector<double> x_;   // evaluation point: the fixed values plus the two slice variables
+    std::vector<Cell> cells_;
+    std::unordered_map<std::uint64_t, double> values_;
+    std::priority_queue<std::pair<double, int>> queue_;   // (error estimate, leaf)
+    double lo_, hi_;
+};
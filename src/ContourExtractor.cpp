@@ -0,0 +1,140 @@
+#include "ContourExtractor.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cstdint>
+
+std::vector<double> contourLevels(double zMin, double zMax, int count)
+{
+    std::vector<double> levels;
+    if(count <= 0 || !(zMax > zMin)) return levels;
+    levels.reserve(static_cast<size_t>(count));
+    for(int k=0;k<count;k++) levels.push_back(zMin + (k + 0.5)*(zMax - zMin)/count);
+    return levels;
+}
+
+namespace {
+
+// Cell edges: 0 bottom (a-b), 1 right (b-c), 2 top (d-c), 3 left (a-d), with corners
+// a = (i, j), b = (i+1, j), c = (i+1, j+1), d = (i, j+1). Up to two segments per case
+// (index: a | b<<1 | c<<2 | d<<3 inside); saddles 5 and 10 list the variant for a centre
+// outside, kSaddleInside the one for a centre inside.
+constexpr size_t kMaxLevels = 65535;   // bands are 16 bit
+
+constexpr std::int8_t kSegments[16][4] = {
+    {-1,-1,-1,-1}, { 3, 0,-1,-1}, { 0, 1,-1,-1}, { 3, 1,-1,-1},
+    { 1, 2,-1,-1}, { 3, 0, 1, 2}, { 0, 2,-1,-1}, { 2, 3,-1,-1},
+    { 2, 3,-1,-1}, { 0, 2,-1,-1}, { 0, 1, 2, 3}, { 1, 2,-1,-1},
+    { 1, 3,-1,-1}, { 0, 1,-1,-1}, { 3, 0,-1,-1}, {-1,-1,-1,-1},
+};
+constexpr std::int8_t kSaddleInside[2][4] = {
+    { 0, 1, 2, 3},   // case 5: a and c joined, b and d cut off
+    { 3, 0, 1, 2},   // case 10: b and d joined, a and c cut off
+};
+
+// Number of levels <= v, by a binary search without branches (the samples of a slice
+// fall between levels unpredictably).
+inline std::uint16_t bandOf(const std::vector<double>& levels, double v)
+{
+    const double* base = levels.data();
+    size_t len = levels.size();
+    while(len > 1){
+        const size_t half = len / 2;
+        base = base[half-1] <= v ? base + half : base;
+        len -= half;
+    }
+    return static_cast<std::uint16_t>((base - levels.data()) + (*base <= v));
+}
+
+} // namespace
+
+ContourLines extractContours(const HeightGrid& grid, std::vector<double> levels, const std::atomic<bool>* cancel)
+{
+    ContourLines out;
+    out.levels = std::move(levels);
+    std::sort(out.levels.begin(), out.levels.end());
+    if(out.levels.size() > kMaxLevels) out.levels.resize(kMaxLevels);
+    const int N = grid.n;
+    if(N < 2 || out.levels.empty() || grid.z.size() != static_cast<size_t>(N)*static_cast<size_t>(N)) return out;
+
+    const double* z = grid.z.data();
+    const std::vector<double>& L = out.levels;
+    const float scale = 2.0f / float(N-1);
+
+    ThreadPool& pool = ThreadPool::global();
+    const int cellRows = N-1;
+    const int grain = std::max(1, cellRows / (4*pool.concurrency()));
+    const size_t tiles = static_cast<size_t>((cellRows + grain - 1) / grain);
+    std::atomic<bool> stopped{false};
+
+    // band[k] = number of levels at or below sample k. A level cuts a cell iff it lies
+    // between the smallest and largest band of its corners, and a corner is inside level
+    // m iff its band exceeds m, so cells are classified with integers and no search.
+    std::vector<std::uint16_t> band(grid.z.size());
+    pool.parallelFor(N, std::max(1, N / (4*pool.concurrency())), [&](int j0, int j1){
+        for(size_t k=static_cast<size_t>(j0)*static_cast<size_t>(N); k<static_cast<size_t>(j1)*static_cast<size_t>(N); k++)
+            band[k] = bandOf(L, z[k]);
+    });
+
+    // Calls emit(i, j, l, a, b, c, d, seg, points) for every cell (i, j) of rows [j0, j1)
+    // and level l that cuts it; seg lists `points` cell edges, two per segment.
+    auto march = [&](int j0, int j1, auto&& emit){
+        for(int j=j0;j<j1;j++){
+            if(cancel && cancel->load(std::memory_order_relaxed)){ stopped = true; return; }
+            const size_t row = static_cast<size_t>(j)*static_cast<size_t>(N);
+            const double* r0 = z + row;
+            const double* r1 = r0 + N;
+            const std::uint16_t* b0 = band.data() + row;
+            const std::uint16_t* b1 = b0 + N;
+            for(int i=0;i<N-1;i++){
+                const int ba = b0[i], bb = b0[i+1], bc = b1[i+1], bd = b1[i];
+                const int first = std::min(std::min(ba, bb), std::min(bc, bd));
+                const int last  = std::max(std::max(ba, bb), std::max(bc, bd));
+                if(first == last) continue;
+
+                const double a = r0[i], b = r0[i+1], c = r1[i+1], d = r1[i];
+                for(int m=first;m<last;m++){
+                    const int index = (ba>m) | (bb>m)<<1 | (bc>m)<<2 | (bd>m)<<3;
+                    const double l = L[static_cast<size_t>(m)];
+                    const std::int8_t* seg = kSegments[index];
+                    if((index==5 || index==10) && 0.25*(a+b+c+d) >= l) seg = kSaddleInside[index==10];
+                    emit(i, j, l, a, b, c, d, seg, seg[2] < 0 ? 2 : 4);
+                }
+            }
+        }
+    };
+
+    // Two passes, so that every tile writes its segments straight into place: the first
+    // counts the vertices of each tile, the second fills them in.
+    std::vector<size_t> offset(tiles + 1, 0);
+    pool.parallelFor(cellRows, grain, [&](int j0, int j1){
+        size_t count = 0;
+        march(j0, j1, [&](int, int, double, double, double, double, double, const std::int8_t*, int points){
+            count += static_cast<size_t>(points);
+        });
+        offset[static_cast<size_t>(j0 / grain) + 1] = count;
+    });
+    if(stopped) return out;
+    for(size_t t=0;t<tiles;t++) offset[t+1] += offset[t];
+    out.vertices.resize(offset[tiles]*3);
+
+    pool.parallelFor(cellRows, grain, [&](int j0, int j1){
+        float* p = out.vertices.data() + offset[static_cast<size_t>(j0 / grain)]*3;
+        march(j0, j1, [&](int i, int j, double l, double a, double b, double c, double d,
+                          const std::int8_t* seg, int points){
+            for(int s=0; s<points; s++, p+=3){
+                double gx = 0.0, gy = 0.0;
+                switch(seg[s]){
+                    case 0: gx = i + (l-a)/(b-a); gy = j;               break;
+                    case 1: gx = i+1;             gy = j + (l-b)/(c-b); break;
+                    case 2: gx = i + (l-d)/(c-d); gy = j+1;             break;
+                    case 3: gx = i;               gy = j + (l-a)/(d-a); break;
+                }
+                p[0] = float(gx)*scale - 1.0f;
+                p[1] = float(gy)*scale - 1.0f;
+                p[2] = float(l);
+            }
+        });
+    });
+    if(stopped) out.vertices.clear();
+    return out;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include "GridSampler.h"
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Isolines of a sampled slice, as line segments ready for GL_LINES.
+struct ContourLines
+{
+    std::vector<double> levels;   // ascending
+    // Two vertices per segment, three floats per vertex: x, y in [-1, 1] across the grid
+    // (like the mesh vertices) and the level value.
+    std::vector<float> vertices;
+
+    std::size_t segments() const { return vertices.size() / 6; }
+};
+
+// count levels spread evenly inside the range: zMin + (k + 0.5)·(zMax - zMin)/count.
+std::vector<double> contourLevels(double zMin, double zMax, int count);
+
+// Marching squares over grid.z, read in place. Corners at or above a level count as
+// inside; saddle cells are resolved by the mean of their corners. Rows of cells are split
+// into tiles on ThreadPool::global(); a counting pass sizes the output so that each tile
+// writes its segments straight into `vertices`. A crossing point is computed from its
+// edge alone, with the lower-index sample first, so the segments of neighbouring cells
+// (and tiles) meet exactly at shared edges. The output is in row-major cell order whatever
+// the number of threads. At most 65535 levels are used. Returns no segments if `cancel`
+// was raised.
+ContourLines extractContours(const HeightGrid& grid, std::vector<double> levels,
+                             const std::atomic<bool>* cancel = nullptr);
@@ -0,0 +1,227 @@
+#include "GridSampler.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+void displayRange(double lo, double hi, double& zMin, double& zMax)
+{
+    if(!std::isfinite(lo) || !std::isfinite(hi) || hi==lo){
+        lo = 0.0; hi = 1.0;
+    }
+    zMin = lo;
+    zMax = hi;
+}
+
+double displayValue(double z)
+{
+    if(!std::isfinite(z)) return 0.0;
+
+    // tame extremes to keep mesh readable
+    if(std::fabs(z) > 1e12) z = (z>0?1e12:-1e12);
+    return z;
+}
+
+GridSampler::GridSampler(const ObjectiveFunction& obj, const SliceSpec& spec, bool rawValues)
+    : spec_(spec), valid_(obj.dimension()==spec.dim), raw_(rawValues)
+{
+    if(static_cast<int>(spec_.fixed.size()) != spec_.dim) spec_.fixed.assign(static_cast<size_t>(spec_.dim), 0.0);
+    if(valid_) plan_ = obj.specializeSlice(spec_.xAxis, spec_.yAxis, spec_.fixed);
+
+    const int N = spec_.n;
+    const double loX = spec_.lower[static_cast<size_t>(spec_.xAxis)];
+    const double hiX = spec_.upper[static_cast<size_t>(spec_.xAxis)];
+    xs_.resize(static_cast<size_t>(std::max(N, 0)));
+    for(int i=0;i<N;i++){
+        const double tx = double(i)/(N-1);
+        xs_[static_cast<size_t>(i)] = loX + (hiX-loX)*tx;
+    }
+
+    // Terms in x alone are the same on every row: tabulate them once, with their slopes
+    // (one dual pass) for sampling with slopes.
+    termColumns_.resize(plan_.terms.size());
+    termSlopes_.resize(plan_.terms.size());
+    const ObjectiveFunction::Column xcol{xs_.data(), 1};
+    const double one = 1.0;
+    const ObjectiveFunction::Column unit{&one, 0};
+    for(size_t k=0;k<plan_.terms.size();k++){
+        if(plan_.termAxis[k]!=0) continue;
+        termColumns_[k].resize(xs_.size());
+        termSlopes_[k].resize(xs_.size());
+        plan_.terms[k].evaluateBatchDual(&xcol, &unit, 1, xs_.size(), termColumns_[k].data(), termSlopes_[k].data());
+    }
+}
+
+double GridSampler::yAt(int j) const
+{
+    const double loY = spec_.lower[static_cast<size_t>(spec_.yAxis)];
+    const double hiY = spec_.upper[static_cast<size_t>(spec_.yAxis)];
+    const double ty = double(j)/(spec_.n-1);
+    return loY + (hiY-loY)*ty;
+}
+
+GridSampler::RowInputs GridSampler::makeInputs() const
+{
+    // y and the per-row terms are broadcast; x and the per-column terms are set per row.
+    RowInputs in;
+    const size_t vars = static_cast<size_t>(std::max(plan_.main.dimension(), 2));
+    in.x.assign(vars, 0.0);
+    in.cols.resize(vars);
+    for(size_t k=0;k<vars;k++) in.cols[k] = {&in.x[k], 0};
+
+    // x and y are the directions themselves; a term moves along its own axis only.
+    static const double one = 1.0;
+    in.ySlopes.assign(vars, 0.0);
+    in.seeds.assign(2*vars, ObjectiveFunction::Column{nullptr, 0});
+    in.seeds[0] = {&one, 0};
+    in.seeds[3] = {&one, 0};
+    for(size_t k=0;k<plan_.terms.size();k++){
+        if(plan_.termAxis[k]==0) continue;
+        in.seeds[2*(2+k) + 1] = {&in.ySlopes[2+k], 0};
+    }
+    return in;
+}
+
+void GridSampler::evalRow(RowInputs& in, int j, int first, int stride, int count, double* out,
+                          double* slopes) const
+{
+    in.x[1] = yAt(j);
+    in.cols[0] = {xs_.data() + first, stride};
+    for(size_t k=0;k<plan_.terms.size();k++){
+        if(plan_.termAxis[k]==0){
+            in.cols[2+k] = {termColumns_[k].data() + first, stride};
+            if(slopes) in.seeds[2*(2+k)] = {termSlopes_[k].data() + first, stride};
+        } else if(slopes){
+            in.x[2+k] = plan_.terms[k].evaluateGradient(&in.x[1], &in.ySlopes[2+k]);
+        } else {
+            in.x[2+k] = plan_.terms[k].evaluate(&in.x[1]);
+        }
+    }
+
+    const size_t n = static_cast<size_t>(count);
+    if(!valid_){
+        std::fill(out, out+count, std::numeric_limits<double>::quiet_NaN());
+        if(slopes) std::fill(slopes, slopes + 2*n, std::numeric_limits<double>::quiet_NaN());
+    } else if(slopes){
+        // The seeds chain the term slopes into df/dx and df/dy.
+        plan_.main.evaluateBatchDual(in.cols.data(), in.seeds.data(), 2, n, out, slopes);
+    } else {
+        plan_.main.evaluateBatch(in.cols.data(), n, out);
+    }
+
+    if(raw_) return;
+    // A replaced value has no slope; NaN lets the mesh fall back to triangle normals there.
+    for(int k=0;k<count;k++){
+        const double z = displayValue(out[k]);
+        if(slopes && !(z==out[k])){
+            slopes[k] = std::numeric_limits<double>::quiet_NaN();
+            slopes[n + static_cast<size_t>(k)] = std::numeric_limits<double>::quiet_NaN();
+        }
+        out[k] = z;
+    }
+}
+
+bool GridSampler::sampleRows(int rowBegin, int rowEnd, double* out, const std::atomic<bool>* cancel) const
+{
+    const int N = spec_.n;
+    RowInputs in = makeInputs();
+
+    for(int j=rowBegin;j<rowEnd;j++){
+        if(cancel && cancel->load(std::memory_order_relaxed)) return false;
+        evalRow(in, j, 0, 1, N, out + static_cast<size_t>(j-rowBegin)*static_cast<size_t>(N));
+    }
+    return true;
+}
+
+bool GridSampler::sample(HeightGrid& grid, const std::atomic<bool>* cancel) const
+{
+    const int N = spec_.n;
+    grid.n = N;
+    grid.z.assign(static_cast<size_t>(N)*static_cast<size_t>(N), 0.0);
+    if(N<2) return true;
+
+    double lo = std::numeric_limits<double>::infinity();
+    double hi = -std::numeric_limits<double>::infinity();
+    if(!sampleLevel(grid, 1, 0, lo, hi, cancel)) return false;
+
+    displayRange(lo, hi, grid.zMin, grid.zMax);
+    return true;
+}
+
+std::vector<int> GridSampler::refinementSteps(int n, int coarseCells)
+{
+    // Coarsest step: the power of two nearest (in ratio) to (n-1)/coarseCells.
+    std::vector<int> steps;
+    int step = 1;
+    while(n>1 && coarseCells>0 && (n-1) >= std::sqrt(2.0)*step*coarseCells) step *= 2;
+    for(; step>=1; step/=2) steps.push_back(step);
+    return steps;
+}
+
+bool GridSampler::sampleLevel(HeightGrid& grid, int step, int prevStep, double& lo, double& hi,
+                              const std::atomic<bool>* cancel) const
+{
+    const int N = spec_.n;
+    const int rows = levelSize(N, step);
+
+    // Row tiles; each tile reports its own min/max, reduced afterwards.
+    ThreadPool& pool = ThreadPool::global();
+    const int rowsPerTile = std::max(1, rows / (4*pool.concurrency()));
+    const int tiles = (rows + rowsPerTile - 1) / rowsPerTile;
+    std::vector<double> tileMin(static_cast<size_t>(tiles),  std::numeric_limits<double>::infinity());
+    std::vector<double> tileMax(static_cast<size_t>(tiles), -std::numeric_limits<double>::infinity());
+
+    const bool withSlopes = grid.hasSlopes();
+    const bool ragged = (N-1) % step != 0;
+    pool.parallelFor(rows, rowsPerTile, [&](int r0, int r1){
+        RowInputs in = makeInputs();
+        std::vector<double> buf(static_cast<size_t>(N));
+        std::vector<double> slopes(withSlopes ? 2*static_cast<size_t>(N) : 0);
+        double tlo = std::numeric_limits<double>::infinity();
+        double thi = -std::numeric_limits<double>::infinity();
+
+        // Evaluates columns first, first+stride, ... of row j into the grid.
+        auto put = [&](int j, int first, int stride, int count){
+            double* row = grid.z.data() + static_cast<size_t>(j)*static_cast<size_t>(N);
+            double* out = (stride==1 && count==N) ? row : buf.data();
+            evalRow(in, j, first, stride, count, out, withSlopes ? slopes.data() : nullptr);
+
+            for(int k=0;k<count;k++){
+                const double z = out[k];
+                if(out!=row) row[first + k*stride] = z;
+                if(z<tlo) tlo=z;
+                if(z>thi) thi=z;
+            }
+            if(withSlopes){
+                const size_t base = static_cast<size_t>(j)*static_cast<size_t>(N) + static_cast<size_t>(first);
+                for(int k=0;k<count;k++){
+                    const size_t at = base + static_cast<size_t>(k)*static_cast<size_t>(stride);
+                    grid.dzdx[at] = slopes[static_cast<size_t>(k)];
+                    grid.dzdy[at] = slopes[static_cast<size_t>(count + k)];
+                }
+            }
+        };
+
+        for(int r=r0;r<r1;r++){
+            if(cancel && cancel->load(std::memory_order_relaxed)) return;
+            const int j = levelIndex(r, N, step);
+
+            // Rows of the previous level already hold every other point of this level,
+            // and the last column.
+            if(prevStep>0 && (j%prevStep==0 || j==N-1)){
+                if(step < N-1) put(j, step, prevStep, (N-2-step)/prevStep + 1);
+                continue;
+            }
+            put(j, 0, step, (N-1)/step + 1);
+            if(ragged) put(j, N-1, 1, 1);
+        }
+        tileMin[static_cast<size_t>(r0/rowsPerTile)] = tlo;
+        tileMax[static_cast<size_t>(r0/rowsPerTile)] = thi;
+    });
+
+    if(cancel && cancel->load()) return false;
+
+    lo = std::min(lo, *std::min_element(tileMin.begin(), tileMin.end()));
+    hi = std::max(hi, *std::max_element(tileMax.begin(), tileMax.end()));
+    return true;
+}
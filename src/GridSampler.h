@@ -0,0 +1,104 @@
+#pragma once
+#include "ObjectiveFunction.h"
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+// A 2D slice through an n-dimensional objective: xAxis/yAxis vary over their bounds on an
+// n×n grid, every other variable is held at its fixed value.
+struct SliceSpec
+{
+    int dim{2};
+    int xAxis{0};
+    int yAxis{1};
+    int n{81};
+    std::vector<double> lower, upper, fixed;
+};
+
+// Sampled heights, row-major: z[j*n + i] is f at (x_i, y_j).
+struct HeightGrid
+{
+    int n{0};
+    std::vector<double> z;
+    double zMin{0.0}, zMax{1.0};
+    // Optional slopes df/dx and df/dy (along the slice axes) at the same points. Empty
+    // unless sampled; NaN where z was replaced by displayValue().
+    std::vector<double> dzdx, dzdy;
+
+    bool hasSlopes() const { return !z.empty() && dzdx.size()==z.size() && dzdy.size()==z.size(); }
+};
+
+// Display range for sampled values lo..hi; empty or degenerate ranges map to [0, 1].
+void displayRange(double lo, double hi, double& zMin, double& zMax);
+
+// Sampled value as displayed: non-finite values become 0 and magnitudes are clamped to 1e12
+// to keep the mesh readable.
+double displayValue(double z);
+
+// Evaluates a slice with the batched evaluator, one grid row per call. The expression is
+// specialised for the slice first (ObjectiveFunction::specializeSlice): terms in x alone
+// are computed once per column at construction, terms in y alone once per row. Non-finite
+// values become 0 and magnitudes are clamped to 1e12 to keep the mesh readable, unless
+// rawValues is set: values are then returned as evaluated (NaN, ±inf), as for export.
+class GridSampler
+{
+public:
+    GridSampler(const ObjectiveFunction& obj, const SliceSpec& spec, bool rawValues = false);
+
+    int n() const { return spec_.n; }
+    const SlicePlan& plan() const { return plan_; }
+    double xAt(int i) const { return xs_[static_cast<size_t>(i)]; }
+    double yAt(int j) const;
+
+    // Rows [rowBegin, rowEnd) into out (n values per row). Safe to call concurrently.
+    // `cancel` is polled before every row; returns false if it was raised.
+    bool sampleRows(int rowBegin, int rowEnd, double* out, const std::atomic<bool>* cancel = nullptr) const;
+
+    // Whole grid, split into row tiles on ThreadPool::global(). The result does not depend
+    // on the number of threads. Returns false if cancelled (grid contents are then undefined).
+    bool sample(HeightGrid& grid, const std::atomic<bool>* cancel = nullptr) const;
+
+    // Coarse-to-fine refinement. Level `step` is the sub-grid of points whose indices are
+    // multiples of step or n-1, so every level spans the whole slice; its last cell is short
+    // when step does not divide n-1. Steps are powers of two, coarsest first, ending with 1;
+    // the coarsest has about coarseCells cells per side (or is the full grid).
+    static std::vector<int> refinementSteps(int n, int coarseCells = 20);
+
+    // Points per side of level `step`, and the grid index of its i-th row/column.
+    static int levelSize(int n, int step) { return n<2 ? n : (n-2)/step + 2; }
+    static int levelIndex(int i, int n, int step) { return std::min(i*step, n-1); }
+
+    // Evaluates the points of level `step` that are not already on level `prevStep`
+    // (0 if nothing has been sampled yet) into grid.z, which must hold n×n values.
+    // lo/hi are widened by the new values. Each point is evaluated exactly once over a
+    // full refinement sequence, with the same result as sample(). If grid.dzdx and
+    // grid.dzdy hold n×n values as well, the slopes are computed in the same pass
+    // (ObjectiveFunction::evaluateBatchDual).
+    bool sampleLevel(HeightGrid& grid, int step, int prevStep, double& lo, double& hi,
+                     const std::atomic<bool>* cancel = nullptr) const;
+
+private:
+    // Scratch inputs owned by one worker: broadcast values (y and per-row terms) plus one
+    // column per variable of the specialised program.
+    // With slopes, seeds[v*2 + l] is the derivative of variable v along x (l = 0) or y (l = 1).
+    struct RowInputs {
+        std::vector<double> x;
+        std::vector<ObjectiveFunction::Column> cols;
+        std::vector<double> ySlopes;   // per-row terms: d t_k / dy
+        std::vector<ObjectiveFunction::Column> seeds;
+    };
+    RowInputs makeInputs() const;
+
+    // count points of row j at columns first, first+stride, ... into out; with `slopes`,
+    // df/dx into slopes[0..count) and df/dy into slopes[count..2*count).
+    void evalRow(RowInputs& in, int j, int first, int stride, int count, double* out,
+                 double* slopes = nullptr) const;
+
+    SliceSpec spec_;
+    bool valid_{false};
+    bool raw_{false};
+    SlicePlan plan_;
+    std::vector<double> xs_;
+    std::vector<std::vector<double>> termColumns_;   // n values for each term in x, else empty
+    std::vector<std::vector<double>> termSlopes_;    // d t_k / dx alongside termColumns_
+};
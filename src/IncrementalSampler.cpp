@@ -0,0 +1,113 @@
+#include "IncrementalSampler.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <limits>
+
+IncrementalSampler::IncrementalSampler(const ObjectiveFunction& obj, const SliceSpec& spec, int var)
+    : spec_(spec), var_(var),
+      valid_(obj.dimension()==spec.dim && var>=0 && var<spec.dim && var!=spec.xAxis && var!=spec.yAxis)
+{
+    if(static_cast<int>(spec_.fixed.size()) != spec_.dim) spec_.fixed.assign(static_cast<size_t>(spec_.dim), 0.0);
+    base_ = SliceKey::of(obj, spec_);
+    if(!valid_) return;
+    base_.fixed[static_cast<size_t>(var_)] = 0.0;
+    plan_ = obj.specializeIncremental(spec_.xAxis, spec_.yAxis, var_, spec_.fixed);
+}
+
+bool IncrementalSampler::accepts(const ObjectiveFunction& obj, const SliceSpec& spec) const
+{
+    if(!valid_ || spec.dim != spec_.dim) return false;
+    SliceKey k = SliceKey::of(obj, spec);
+    k.fixed[static_cast<size_t>(var_)] = 0.0;
+    return k == base_;
+}
+
+std::size_t IncrementalSampler::partBytes() const
+{
+    const size_t points = static_cast<size_t>(spec_.n)*static_cast<size_t>(spec_.n);
+    return plan_.parts.size() * points * sizeof(double);
+}
+
+bool IncrementalSampler::prepare(const std::atomic<bool>* cancel)
+{
+    if(prepared_ || !valid_) return prepared_;
+    const int N = spec_.n;
+    const size_t rowLen = static_cast<size_t>(N);
+    const size_t ax = static_cast<size_t>(spec_.xAxis), ay = static_cast<size_t>(spec_.yAxis);
+
+    // Same coordinates as GridSampler.
+    std::vector<double> xs(rowLen), ys(rowLen);
+    for(int i=0;i<N;i++){
+        const double t = double(i)/(N-1);
+        xs[static_cast<size_t>(i)] = spec_.lower[ax] + (spec_.upper[ax]-spec_.lower[ax])*t;
+        ys[static_cast<size_t>(i)] = spec_.lower[ay] + (spec_.upper[ay]-spec_.lower[ay])*t;
+    }
+
+    std::vector<std::vector<double>> values(plan_.parts.size());
+    for(auto& v : values) v.resize(rowLen*rowLen);
+
+    // Raw part values (no displayValue(): they are operands of `top`).
+    std::atomic<bool> stopped{false};
+    ThreadPool& pool = ThreadPool::global();
+    pool.parallelFor(N, std::max(1, N / (4*pool.concurrency())), [&](int j0, int j1){
+        for(int j=j0;j<j1;j++){
+            if(cancel && cancel->load(std::memory_order_relaxed)){ stopped = true; return; }
+            const ObjectiveFunction::Column cols[2] = {{xs.data(), 1}, {&ys[static_cast<size_t>(j)], 0}};
+            for(size_t k=0;k<plan_.parts.size();k++)
+                plan_.parts[k].evaluateBatch(cols, rowLen, values[k].data() + static_cast<size_t>(j)*rowLen);
+        }
+    });
+    if(stopped) return false;
+
+    partValues_ = std::move(values);
+    prepared_ = true;
+    return true;
+}
+
+bool IncrementalSampler::sample(double value, HeightGrid& grid, const std::atomic<bool>* cancel) const
+{
+    const int N = spec_.n;
+    const size_t rowLen = static_cast<size_t>(N);
+    grid.n = N;
+    grid.z.assign(rowLen*rowLen, 0.0);
+    if(!prepared_) return false;
+    if(N<2) return true;
+
+    // Whatever depends on the value alone folds into constants.
+    const ObjectiveFunction top = plan_.top.bindVariable(0, value);
+
+    ThreadPool& pool = ThreadPool::global();
+    const int rowsPerTile = std::max(1, N / (4*pool.concurrency()));
+    const int tiles = (N + rowsPerTile - 1) / rowsPerTile;
+    std::vector<double> tileMin(static_cast<size_t>(tiles),  std::numeric_limits<double>::infinity());
+    std::vector<double> tileMax(static_cast<size_t>(tiles), -std::numeric_limits<double>::infinity());
+    std::atomic<bool> stopped{false};
+
+    pool.parallelFor(N, rowsPerTile, [&](int j0, int j1){
+        if(cancel && cancel->load(std::memory_order_relaxed)){ stopped = true; return; }
+        // A tile of whole rows is contiguous in every part, so `top` runs over it in one call.
+        const size_t first = static_cast<size_t>(j0)*rowLen;
+        const size_t count = static_cast<size_t>(j1-j0)*rowLen;
+        std::vector<ObjectiveFunction::Column> cols(1 + partValues_.size());
+        cols[0] = {&value, 0};
+        for(size_t k=0;k<partValues_.size();k++) cols[1+k] = {partValues_[k].data() + first, 1};
+        double* out = grid.z.data() + first;
+        top.evaluateBatch(cols.data(), count, out);
+
+        double lo = std::numeric_limits<double>::infinity();
+        double hi = -std::numeric_limits<double>::infinity();
+        for(size_t k=0;k<count;k++){
+            out[k] = displayValue(out[k]);
+            lo = std::min(lo, out[k]);
+            hi = std::max(hi, out[k]);
+        }
+        tileMin[static_cast<size_t>(j0/rowsPerTile)] = lo;
+        tileMax[static_cast<size_t>(j0/rowsPerTile)] = hi;
+    });
+    if(stopped) return false;
+
+    const double lo = *std::min_element(tileMin.begin(), tileMin.end());
+    const double hi = *std::max_element(tileMax.begin(), tileMax.end());
+    displayRange(lo, hi, grid.zMin, grid.zMax);
+    return true;
+}
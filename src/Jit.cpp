@@ -0,0 +1,190 @@
+#include "Jit.h"
+#include <cstring>
+
+#if defined(FVT_ENABLE_JIT) && defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__))
+#define FVT_JIT_X86_64 1
+#include <sys/mman.h>
+#endif
+
+JitCode::JitCode(void* mem, std::size_t size)
+    : mem_(mem), size_(size), fn_(reinterpret_cast<Fn>(mem))
+{
+}
+
+JitCode::~JitCode()
+{
+#if defined(FVT_JIT_X86_64)
+    if(mem_) munmap(mem_, size_);
+#endif
+}
+
+bool JitAssembler::supported()
+{
+#if defined(FVT_JIT_X86_64)
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Frame layout: [rsp + 8*k] holds stack level k (k < maxStack), followed by the registers.
+// rbx keeps the argument pointer across calls.
+JitAssembler::JitAssembler(int maxStack, int numRegs)
+    : maxStack_(maxStack)
+{
+    // Entry rsp is 8 mod 16; push rbx realigns it, so the frame must be a multiple of 16.
+    frame_ = static_cast<std::int32_t>(((8*(maxStack + numRegs)) + 15) & ~15);
+    bytes({0x53});                       // push rbx
+    bytes({0x48, 0x89, 0xFB});           // mov rbx, rdi
+    bytes({0x48, 0x81, 0xEC});           // sub rsp, frame
+    imm32(frame_);
+}
+
+void JitAssembler::bytes(std::initializer_list<std::uint8_t> b)
+{
+    buf_.insert(buf_.end(), b.begin(), b.end());
+}
+
+void JitAssembler::imm32(std::int32_t v)
+{
+    std::uint8_t b[4];
+    std::memcpy(b, &v, 4);
+    buf_.insert(buf_.end(), b, b+4);
+}
+
+void JitAssembler::imm64(std::uint64_t v)
+{
+    std::uint8_t b[8];
+    std::memcpy(b, &v, 8);
+    buf_.insert(buf_.end(), b, b+8);
+}
+
+void JitAssembler::slotToXmm(int xmm, int slot)
+{
+    bytes({0xF2, 0x0F, 0x10, static_cast<std::uint8_t>(0x84 | (xmm << 3)), 0x24});
+    imm32(8*slot);
+}
+
+void JitAssembler::spillTop()
+{
+    if(depth_ == 0) return;
+    bytes({0xF2, 0x0F, 0x11, 0x84, 0x24});   // movsd [rsp + 8*(depth-1)], xmm0
+    imm32(8*(depth_ - 1));
+}
+
+void JitAssembler::pushConst(double v)
+{
+    spillTop();
+    std::uint64_t bits;
+    std::memcpy(&bits, &v, 8);
+    bytes({0x48, 0xB8}); imm64(bits);         // mov rax, imm64
+    bytes({0x66, 0x48, 0x0F, 0x6E, 0xC0});    // movq xmm0, rax
+    depth_++;
+}
+
+void JitAssembler::pushVar(int index)
+{
+    spillTop();
+    bytes({0xF2, 0x0F, 0x10, 0x83});          // movsd xmm0, [rbx + 8*index]
+    imm32(8*index);
+    depth_++;
+}
+
+void JitAssembler::store(int reg)
+{
+    bytes({0xF2, 0x0F, 0x11, 0x84, 0x24});    // movsd [rsp + 8*(maxStack+reg)], xmm0
+    imm32(8*(maxStack_ + reg));
+}
+
+void JitAssembler::load(int reg)
+{
+    spillTop();
+    slotToXmm(0, maxStack_ + reg);
+    depth_++;
+}
+
+void JitAssembler::arith(Arith op)
+{
+    // b is in xmm0, a in the slot below: xmm1 = b, xmm0 = a, xmm0 = a (op) b.
+    bytes({0x66, 0x0F, 0x28, 0xC8});          // movapd xmm1, xmm0
+    slotToXmm(0, depth_ - 2);
+    std::uint8_t opc = 0x58;
+    switch(op){
+        case Arith::Add: opc = 0x58; break;
+        case Arith::Sub: opc = 0x5C; break;
+        case Arith::Mul: opc = 0x59; break;
+        case Arith::Div: opc = 0x5E; break;
+        case Arith::Min: opc = 0x5D; break;   // minsd: a<b ? a : b
+        case Arith::Max: opc = 0x5F; break;   // maxsd: a>b ? a : b
+    }
+    bytes({0xF2, 0x0F, opc, 0xC1});
+    depth_--;
+}
+
+void JitAssembler::sqrt()
+{
+    bytes({0xF2, 0x0F, 0x51, 0xC0});          // sqrtsd xmm0, xmm0
+}
+
+void JitAssembler::abs()
+{
+    bytes({0x48, 0xB8}); imm64(0x7FFFFFFFFFFFFFFFull);
+    bytes({0x66, 0x48, 0x0F, 0x6E, 0xC8});    // movq xmm1, rax
+    bytes({0x66, 0x0F, 0x54, 0xC1});          // andpd xmm0, xmm1
+}
+
+void JitAssembler::neg()
+{
+    bytes({0x66, 0x0F, 0x57, 0xC9});          // xorpd xmm1, xmm1
+    bytes({0xF2, 0x0F, 0x5C, 0xC8});          // subsd xmm1, xmm0
+    bytes({0x66, 0x0F, 0x28, 0xC1});          // movapd xmm0, xmm1
+}
+
+void JitAssembler::sqr()
+{
+    bytes({0xF2, 0x0F, 0x59, 0xC0});          // mulsd xmm0, xmm0
+}
+
+void JitAssembler::cube()
+{
+    bytes({0x66, 0x0F, 0x28, 0xC8});          // movapd xmm1, xmm0
+    bytes({0xF2, 0x0F, 0x59, 0xC0});          // mulsd xmm0, xmm0
+    bytes({0xF2, 0x0F, 0x59, 0xC1});          // mulsd xmm0, xmm1
+}
+
+void JitAssembler::call1(double (*fn)(double))
+{
+    bytes({0x48, 0xB8}); imm64(reinterpret_cast<std::uint64_t>(fn));
+    bytes({0xFF, 0xD0});                      // call rax
+}
+
+void JitAssembler::call2(double (*fn)(double, double))
+{
+    bytes({0x66, 0x0F, 0x28, 0xC8});          // movapd xmm1, xmm0
+    slotToXmm(0, depth_ - 2);
+    bytes({0x48, 0xB8}); imm64(reinterpret_cast<std::uint64_t>(fn));
+    bytes({0xFF, 0xD0});                      // call rax
+    depth_--;
+}
+
+std::shared_ptr<const JitCode> JitAssembler::finish()
+{
+#if defined(FVT_JIT_X86_64)
+    bytes({0x48, 0x81, 0xC4}); imm32(frame_); // add rsp, frame
+    bytes({0x5B});                            // pop rbx
+    bytes({0xC3});                            // ret
+
+    // Write, then flip the page to read+execute; it is never writable and executable at once.
+    const std::size_t size = buf_.size();
+    void* mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(mem == MAP_FAILED) return nullptr;
+    std::memcpy(mem, buf_.data(), size);
+    if(mprotect(mem, size, PROT_READ | PROT_EXEC) != 0){
+        munmap(mem, size);
+        return nullptr;
+    }
+    return std::shared_ptr<const JitCode>(new JitCode(mem, size));
+#else
+    return nullptr;
+#endif
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <vector>
+
+// Native code for one compiled expression: double f(const double* x).
+class JitCode
+{
+public:
+    using Fn = double (*)(const double* x);
+
+    ~JitCode();
+    JitCode(const JitCode&) = delete;
+    JitCode& operator=(const JitCode&) = delete;
+
+    Fn fn() const { return fn_; }
+    std::size_t size() const { return size_; }
+
+private:
+    friend class JitAssembler;
+    JitCode(void* mem, std::size_t size);
+
+    void* mem_{nullptr};
+    std::size_t size_{0};
+    Fn fn_{nullptr};
+};
+
+// Lowers stack bytecode to x86-64 machine code (System V ABI, scalar SSE2). The top of the
+// evaluation stack is kept in xmm0; deeper levels and registers live in the stack frame,
+// so libm calls need no extra spilling. Results are bit-identical to the interpreter.
+//
+// Only available on x86-64 Linux/macOS builds with FVT_ENABLE_JIT; elsewhere supported()
+// is false and finish() returns nullptr, and callers keep using the interpreter.
+class JitAssembler
+{
+public:
+    enum class Arith { Add, Sub, Mul, Div, Min, Max };
+
+    JitAssembler(int maxStack, int numRegs);
+
+    static bool supported();
+
+    void pushConst(double v);
+    void pushVar(int index);
+    void store(int reg);
+    void load(int reg);
+    void arith(Arith op);
+    void sqrt();
+    void abs();
+    void neg();
+    void sqr();
+    void cube();
+    void call1(double (*fn)(double));
+    void call2(double (*fn)(double, double));
+
+    // Emits the epilogue and maps the code executable; nullptr if unsupported.
+    std::shared_ptr<const JitCode> finish();
+
+private:
+    void bytes(std::initializer_list<std::uint8_t> b);
+    void imm32(std::int32_t v);
+    void imm64(std::uint64_t v);
+    void spillTop();
+    void slotToXmm(int xmm, int slot);   // movsd xmmN, [rsp + 8*slot]
+
+    std::vector<std::uint8_t> buf_;
+    int maxStack_{0};
+    int depth_{0};
+    std::int32_t frame_{0};
+};
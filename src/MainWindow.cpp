@@ -8,6 +8,8 @@
 #include <QMessageBox>
 #include <QHeaderView>
 #include <QSplitter>
+#include <QStandardPaths>
+#include <algorithm>
 #include <cmath>
 
 MainWindow::MainWindow(QWidget* parent): QMainWindow(parent)
@@ -73,12 +75,79 @@ void MainWindow::buildUi()
     wireCheck_ = new QCheckBox("Wireframe", left);
     connect(wireCheck_, &QCheckBox::stateChanged, this, &MainWindow::onWireframeChanged);
 
+    heightmapCheck_ = new QCheckBox("GPU heightmap (large grids)", left);
+    heightmapCheck_->setToolTip("Upload only a height texture per rebuild; allows grids up to 4097×4097.");
+    connect(heightmapCheck_, &QCheckBox::stateChanged, this, &MainWindow::onHeightmapChanged);
+
+    adaptiveCheck_ = new QCheckBox("Adaptive sampling", left);
+    adaptiveCheck_->setToolTip("Quadtree sampling with up to the N×N evaluations of the grid, refined where the surface bends most "
+                               "and stopped early where it is flat. Better than the grid for plateaus and localised features; "
+                               "on evenly oscillating functions (Ackley, Levy) the grid is more accurate.");
+    connect(adaptiveCheck_, &QCheckBox::stateChanged, this, &MainWindow::onAdaptiveChanged);
+
+    compactCheck_ = new QCheckBox("Compact vertices", left);
+    compactCheck_->setToolTip("Quantised 12-byte vertices (16-bit position, height and normal); about a third of the vertex memory.");
+    connect(compactCheck_, &QCheckBox::stateChanged, this, &MainWindow::onCompactChanged);
+
+    exactNormalsCheck_ = new QCheckBox("Exact normals", left);
+    exactNormalsCheck_->setToolTip("Normals from the derivatives of f, computed alongside f, instead of from the adjacent triangles.");
+    exactNormalsCheck_->setChecked(true);
+    connect(exactNormalsCheck_, &QCheckBox::stateChanged, this, &MainWindow::onExactNormalsChanged);
+
+    stripCheck_ = new QCheckBox("Triangle strips", left);
+    stripCheck_->setToolTip("Banded triangle strips with primitive restart (about 2.2 indices per cell instead of 6).");
+    stripCheck_->setChecked(true);
+    connect(stripCheck_, &QCheckBox::stateChanged, this, &MainWindow::onStripsChanged);
+
+    contourSpin_ = new QSpinBox(left);
+    contourSpin_->setRange(0, 256);
+    contourSpin_->setSpecialValueText("Off");
+    contourSpin_->setToolTip("Isolines at this many evenly spaced heights, drawn over the surface (uniform grids only).");
+    connect(contourSpin_, &QSpinBox::valueChanged, this, &MainWindow::onContoursChanged);
+
+    topViewCheck_ = new QCheckBox("2D view", left);
+    topViewCheck_->setToolTip("Look straight down on the slice (orthographic); drag to pan.");
+    connect(topViewCheck_, &QCheckBox::stateChanged, this, &MainWindow::onTopViewChanged);
+
+    heatmapPanelCheck_ = new QCheckBox("Heatmap panel", left);
+    heatmapPanelCheck_->setToolTip("A 2D heatmap of the slice below the surface, drawn from the same samples (no extra evaluations).");
+    connect(heatmapPanelCheck_, &QCheckBox::stateChanged, this, &MainWindow::onHeatmapPanelChanged);
+    gpuLabel_ = new QLabel("GPU draw: –", left);
+    minimumLabel_ = new QLabel("Minimum: –", left);
+    minimumLabel_->setWordWrap(true);
+    minimumLabel_->setToolTip("Global minimum of the slice, bracketed by interval branch and bound.");
+
+    cacheSpin_ = new QSpinBox(left);
+    cacheSpin_->setRange(0, 8192);
+    cacheSpin_->setSingleStep(64);
+    cacheSpin_->setSuffix(" MB");
+    cacheSpin_->setValue(int(SliceCache::kDefaultBudget >> 20));
+    cacheSpin_->setToolTip("Memory for sampled grids kept for reuse (keyed by expression, axes, bounds, fixed values and N); 0 disables the cache.");
+    connect(cacheSpin_, &QSpinBox::valueChanged, this, &MainWindow::onCacheBudgetChanged);
+
+    diskCacheCheck_ = new QCheckBox("Keep slow slices on disk", left);
+    diskCacheCheck_->setToolTip("Slices that take a while to sample are also stored (memory-mapped, checksummed) in the user cache directory and reused across sessions.");
+    connect(diskCacheCheck_, &QCheckBox::stateChanged, this, &MainWindow::onDiskCacheChanged);
+
     zScale_ = new QSlider(Qt::Horizontal, left);
     zScale_->setRange(1, 400); // maps to 0.01..4.00
     zScale_->setValue(100);
     connect(zScale_, &QSlider::valueChanged, this, &MainWindow::onZScaleChanged);
     zScaleLabel_ = new QLabel("Z scale: 1.00", left);
 
+    // Scrubs the fixed value of one non-axis variable across its bounds.
+    fixedVarBox_ = new QComboBox(left);
+    connect(fixedVarBox_, &QComboBox::currentIndexChanged, this, &MainWindow::onFixedVarChanged);
+    fixedSlider_ = new QSlider(Qt::Horizontal, left);
+    fixedSlider_->setRange(0, kFixedSteps);
+    connect(fixedSlider_, &QSlider::valueChanged, this, &MainWindow::onFixedSliderMoved);
+    fixedLabel_ = new QLabel("Fixed value", left);
+
+    liveTimer_ = new QTimer(this);
+    liveTimer_->setSingleShot(true);
+    liveTimer_->setInterval(kLiveFrameMs);
+    connect(liveTimer_, &QTimer::timeout, this, &MainWindow::onLiveTimeout);
+
     leftLayout->addLayout(form);
     leftLayout->addWidget(axesBox);
 
@@ -86,8 +155,23 @@ void MainWindow::buildUi()
     auto* gridForm = new QFormLayout(gridBox);
     gridForm->addRow("Grid N×N", gridSpin_);
     gridForm->addRow("", wireCheck_);
+    gridForm->addRow("", heightmapCheck_);
+    gridForm->addRow("", adaptiveCheck_);
+    gridForm->addRow("", compactCheck_);
+    gridForm->addRow("", exactNormalsCheck_);
+    gridForm->addRow("", stripCheck_);
+    gridForm->addRow("Contours", contourSpin_);
+    gridForm->addRow("", topViewCheck_);
+    gridForm->addRow("", heatmapPanelCheck_);
+    gridForm->addRow("", gpuLabel_);
+    gridForm->addRow("", minimumLabel_);
+    gridForm->addRow("Slice cache", cacheSpin_);
+    gridForm->addRow("", diskCacheCheck_);
     gridForm->addRow("", zScaleLabel_);
     gridForm->addRow("", zScale_);
+    gridForm->addRow("Scrub", fixedVarBox_);
+    gridForm->addRow("", fixedLabel_);
+    gridForm->addRow("", fixedSlider_);
     leftLayout->addWidget(gridBox);
 
     auto* tableBox = new QGroupBox("Per-variable bounds / fixed values", left);
@@ -101,6 +185,7 @@ void MainWindow::buildUi()
     table_->horizontalHeader()->setSectionResizeMode(3, QHeaderView::Stretch);
     table_->verticalHeader()->setVisible(false);
     table_->setAlternatingRowColors(true);
+    connect(table_, &QTableWidget::itemChanged, this, &MainWindow::onTableItemChanged);
     tableLay->addWidget(table_);
     leftLayout->addWidget(tableBox, 1);
 
@@ -110,9 +195,19 @@ void MainWindow::buildUi()
 
     splitter->addWidget(left);
 
-    // Right: surface
-    surface_ = new SurfaceWidget(splitter);
-    splitter->addWidget(surface_);
+    // Right: surface, with the heatmap panel below it
+    auto* right = new QSplitter(Qt::Vertical, splitter);
+    surface_ = new SurfaceWidget(right);
+    connect(surface_, &SurfaceWidget::rebuildFinished, this, &MainWindow::onRebuildFinished);
+    connect(surface_, &SurfaceWidget::gpuFrameTimed, this, &MainWindow::onGpuFrameTimed);
+    connect(surface_, &SurfaceWidget::minimumBounded, this, &MainWindow::onMinimumBounded);
+    right->addWidget(surface_);
+    plot_ = new PlotWidget(right);
+    plot_->setVisible(false);
+    right->addWidget(plot_);
+    right->setStretchFactor(0, 3);
+    right->setStretchFactor(1, 2);
+    splitter->addWidget(right);
     splitter->setStretchFactor(0, 0);
     splitter->setStretchFactor(1, 1);
 
@@ -122,300 +217,11 @@ void MainWindow::buildUi()
 
 void MainWindow::populatePresets()
 {
-    presets_.clear();
-
-    auto add = [&](const char* name, const QString& expr, int dim, double lo, double hi){
-        presets_.push_back({QString::fromLatin1(name), expr, dim, lo, hi});
-    };
-
-    auto makeWeierstrass2D = []()->QString{
-        // Standard Weierstrass with a=0.5, b=3, kmax=20 (2D). Domain typically [-0.5, 0.5].
-        // f(x) = sum_i sum_k a^k cos(2*pi*b^k*(x_i+0.5)) - n*sum_k a^k cos(2*pi*b^k*0.5)
-        const int kmax = 20;
-        const double a = 0.5;
-        const double b = 3.0;
-        auto termForX = [&](const QString& xi)->QString{
-            QString s;
-            for(int k=0;k<=kmax;k++){
-                const double ak = std::pow(a, k);
-                const double bk = std::pow(b, k);
-                if(k) s += " + ";
-                s += QString("%1*cos(2*pi*%2*(%3+0.5))").arg(ak,0,'g',17).arg(bk,0,'g',17).arg(xi);
-            }
-            return "(" + s + ")";
-        };
-
-        QString csum;
-        for(int k=0;k<=kmax;k++){
-            const double ak = std::pow(a, k);
-            const double bk = std::pow(b, k);
-            if(k) csum += " + ";
-            csum += QString("%1*cos(2*pi*%2*0.5)").arg(ak,0,'g',17).arg(bk,0,'g',17);
-        }
-        const QString base = termForX("x0") + " + " + termForX("x1");
-        return base + QString(" - 2*(%1)").arg(csum);
-    };
-
-    auto makeHartmann3 = []()->QString{
-        // Hartmann 3D (classic definition), domain [0,1]^3.
-        // f(x) = -sum_{i=1..4} alpha_i * exp(-sum_{j=1..3} A_ij*(x_j - P_ij)^2)
-        const double alpha[4] = {1.0, 1.2, 3.0, 3.2};
-        const double A[4][3] = {
-            {3.0, 10.0, 30.0},
-            {0.1, 10.0, 35.0},
-            {3.0, 10.0, 30.0},
-            {0.1, 10.0, 35.0}
-        };
-        const double P[4][3] = {
-            {0.3689, 0.1170, 0.2673},
-            {0.4699, 0.4387, 0.7470},
-            {0.1091, 0.8732, 0.5547},
-            {0.0381, 0.5743, 0.8828}
-        };
-
-        QString s;
-        for(int i=0;i<4;i++){
-            QString inner;
-            for(int j=0;j<3;j++){
-                if(j) inner += " + ";
-                inner += QString("%1*(x%2-%3)^2").arg(A[i][j],0,'g',17).arg(j).arg(P[i][j],0,'g',17);
-            }
-            const QString term = QString("%1*exp(-(%2))").arg(alpha[i],0,'g',17).arg(inner);
-            if(i) s += " + ";
-            s += term;
-        }
-        return "- (" + s + ")";
-    };
-
-    auto makeHartmann6 = []()->QString{
-        // Hartmann 6D (classic definition), domain [0,1]^6.
-        const double alpha[4] = {1.0, 1.2, 3.0, 3.2};
-        const double A[4][6] = {
-            {10.0, 3.0, 17.0, 3.5, 1.7, 8.0},
-            {0.05, 10.0, 17.0, 0.1, 8.0, 14.0},
-            {3.0, 3.5, 1.7, 10.0, 17.0, 8.0},
-            {17.0, 8.0, 0.05, 10.0, 0.1, 14.0}
-        };
-        const double P[4][6] = {
-            {0.1312, 0.1696, 0.5569, 0.0124, 0.8283, 0.5886},
-            {0.2329, 0.4135, 0.8307, 0.3736, 0.1004, 0.9991},
-            {0.2348, 0.1451, 0.3522, 0.2883, 0.3047, 0.6650},
-            {0.4047, 0.8828, 0.8732, 0.5743, 0.1091, 0.0381}
-        };
-
-        QString s;
-        for(int i=0;i<4;i++){
-            QString inner;
-            for(int j=0;j<6;j++){
-                if(j) inner += " + ";
-                inner += QString("%1*(x%2-%3)^2").arg(A[i][j],0,'g',17).arg(j).arg(P[i][j],0,'g',17);
-            }
-            const QString term = QString("%1*exp(-(%2))").arg(alpha[i],0,'g',17).arg(inner);
-            if(i) s += " + ";
-            s += term;
-        }
-        return "- (" + s + ")";
-    };
-
-    auto makeShekel = [](int m)->QString{
-        // Shekel family (m=5,7,10), 4D, domain [0,10]^4.
-        const double A[10][4] = {
-            {4.0, 4.0, 4.0, 4.0},
-            {1.0, 1.0, 1.0, 1.0},
-            {8.0, 8.0, 8.0, 8.0},
-            {6.0, 6.0, 6.0, 6.0},
-            {3.0, 7.0, 3.0, 7.0},
-            {2.0, 9.0, 2.0, 9.0},
-            {5.0, 5.0, 3.0, 3.0},
-            {8.0, 1.0, 8.0, 1.0},
-            {6.0, 2.0, 6.0, 2.0},
-            {7.0, 3.6, 7.0, 3.6}
-        };
-        const double C[10] = {0.1,0.2,0.2,0.4,0.4,0.6,0.3,0.7,0.5,0.5};
-
-        QString s;
-        for(int i=0;i<m;i++){
-            QString denom;
-            for(int j=0;j<4;j++){
-                if(j) denom += " + ";
-                denom += QString("(x%1-%2)^2").arg(j).arg(A[i][j],0,'g',17);
-            }
-            denom += QString(" + %1").arg(C[i],0,'g',17);
-            const QString term = QString("1/(%1)").arg(denom);
-            if(i) s += " + ";
-            s += term;
-        }
-        return "- (" + s + ")";
-    };
-
-    // Analytic presets (supported by the expression parser)
-    add("rastrigin",
-        QStringLiteral("20 + (x0^2 - 10*cos(2*pi*x0)) + (x1^2 - 10*cos(2*pi*x1))"), 2, -5.12, 5.12);
-    add("rosenbrock",
-        QStringLiteral("(1 - x0)^2 + 100*(x1 - x0^2)^2"), 2, -2.048, 2.048);
-
-    // Framework-specific / not representable as a single analytic string (placeholder in standalone mode)
-    add("potential", QString(), 2, -5.0, 5.0);
-
-    add("ackley",
-        QStringLiteral("-20*exp(-0.2*sqrt(0.5*(x0^2+x1^2))) - exp(0.5*(cos(2*pi*x0)+cos(2*pi*x1))) + 20 + e"), 2, -32.768, 32.768);
-    add("sphere",
-        QStringLiteral("x0^2 + x1^2"), 2, -5.12, 5.12);
-    add("griewank",
-        QStringLiteral("1 + (x0^2 + x1^2)/4000 - cos(x0)*cos(x1/sqrt(2))"), 2, -600.0, 600.0);
-
-    // Levy N.13 (2D)
-    add("levy",
-        QStringLiteral("(sin(3*pi*x0))^2 + (x0-1)^2*(1 + (sin(3*pi*x1))^2) + (x1-1)^2*(1 + (sin(2*pi*x1))^2)"), 2, -10.0, 10.0);
-
-    add("attractivesector", QString(), 2, -5.0, 5.0);
-
-    add("bohachevsky1",
-        QStringLiteral("x0^2 + 2*x1^2 - 0.3*cos(3*pi*x0) - 0.4*cos(4*pi*x1) + 0.7"), 2, -100.0, 100.0);
-    add("bohachevsky2",
-        QStringLiteral("x0^2 + 2*x1^2 - 0.3*cos(3*pi*x0)*cos(4*pi*x1) + 0.3"), 2, -100.0, 100.0);
-    add("bohachevsky3",
-        QStringLiteral("x0^2 + 2*x1^2 - 0.3*cos(3*pi*x0 + 4*pi*x1) + 0.3"), 2, -100.0, 100.0);
-
-    // Branin (classic bounds are per-variable; here an envelope)
-    add("branin",
-        QStringLiteral("(x1 - (5.1/(4*pi^2))*x0^2 + (5/pi)*x0 - 6)^2 + 10*(1 - 1/(8*pi))*cos(x0) + 10"), 2, -5.0, 15.0);
-
-    // Six-hump camel (classic bounds are per-variable; here an envelope)
-    add("camel",
-        QStringLiteral("((4 - 2.1*x0^2 + (x0^4)/3)*x0^2) + (x0*x1) + ((-4 + 4*x1^2)*x1^2)"), 2, -3.0, 3.0);
-
-    add("cigar",
-        QStringLiteral("x0^2 + 1000000*x1^2"), 2, -100.0, 100.0);
-
-    // Cosine Mixture (common variant)
-    add("cosinemixture",
-        QStringLiteral("x0^2 + x1^2 - 0.1*(cos(5*pi*x0) + cos(5*pi*x1))"), 2, -1.0, 1.0);
-
-    add("differentpowers",
-        QStringLiteral("(abs(x0))^2 + (abs(x1))^3"), 2, -1.0, 1.0);
-
-    add("diracproblem", QString(), 2, -5.0, 5.0);
-
-    add("easom",
-        QStringLiteral("-cos(x0)*cos(x1)*exp(-((x0-pi)^2 + (x1-pi)^2))"), 2, -100.0, 100.0);
-
-    // Ellipsoidal (2D specialization). Note: for n=2 it matches the common 1e6-conditioned ellipsoid.
-    add("ellipsoidal",
-        QStringLiteral("x0^2 + 1000000*x1^2"), 2, -5.0, 5.0);
-
-    add("equalmaxima",
-        QStringLiteral("(sin(5*pi*x0))^6"), 2, 0.0, 1.0);
-
-    // Exponential (common benchmark): f(x) = -exp(-0.5*sum x_i^2)
-    add("expotential",
-        QStringLiteral("-exp(-0.5*(x0^2+x1^2))"), 2, -1.0, 1.0);
-
-    add("goldstein",
-        QStringLiteral(
-            "(1 + (x0 + x1 + 1)^2*(19 - 14*x0 + 3*x0^2 - 14*x1 + 6*x0*x1 + 3*x1^2))"
-            " * (30 + (2*x0 - 3*x1)^2*(18 - 32*x0 + 12*x0^2 + 48*x1 - 36*x0*x1 + 27*x1^2))"
-        ),
-        2, -2.0, 2.0);
-
-    // Griewank-Rosenbrock (F8F2, 2D specialization)
-    add("griewankrosenbrock",
-        QStringLiteral("(pow(100*(x0^2 - x1)^2 + (x0-1)^2,2)/4000) - cos(100*(x0^2 - x1)^2 + (x0-1)^2) + 1"),
-        2, -5.0, 5.0);
-
-    // Hansen is not a single canonical definition across benchmark suites; keep placeholder in standalone mode.
-    add("hansen", QString(), 2, -5.0, 5.0);
-
-    add("hartmann3", makeHartmann3(), 3, 0.0, 1.0);
-    add("hartmann6", makeHartmann6(), 6, 0.0, 1.0);
-
-    // Variants typically involve shifting/rotation in their canonical definitions.
-    // In standalone mode, they are kept as placeholders unless you provide the exact variant definition.
-    add("rastrigin2", QString(), 2, -5.12, 5.12);
-    add("rotatedrosenbrock", QString(), 2, -2.048, 2.048);
-
-    add("shekel5",  makeShekel(5), 4, 0.0, 10.0);
-    add("shekel7",  makeShekel(7), 4, 0.0, 10.0);
-    add("shekel10", makeShekel(10), 4, 0.0, 10.0);
-
-    add("shubert",
-        QStringLiteral(
-            "(cos(2*x0 + 1) + 2*cos(3*x0 + 2) + 3*cos(4*x0 + 3) + 4*cos(5*x0 + 4) + 5*cos(6*x0 + 5))"
-            " * (cos(2*x1 + 1) + 2*cos(3*x1 + 2) + 3*cos(4*x1 + 3) + 4*cos(5*x1 + 4) + 5*cos(6*x1 + 5))"
-        ),
-        2, -10.0, 10.0);
-
-    // Step-Ellipsoidal (2D specialization) using floor(x+0.5)
-    add("stepellipsoidal",
-        QStringLiteral("floor(x0+0.5)^2 + 1000000*floor(x1+0.5)^2"), 2, -5.0, 5.0);
-    add("test2n", QString(), 2, -5.0, 5.0);
-    add("test30n", QString(), 30, -5.0, 5.0);
-
-    add("antennaarray", QString(), 2, -5.0, 5.0);
-    add("antennaula", QString(), 2, -5.0, 5.0);
-    add("bifunctionalcatalyst", QString(), 2, -5.0, 5.0);
-    add("bucherastrigin", QString(), 2, -5.0, 5.0);
-    add("cassini", QString(), 2, -5.0, 5.0);
-    add("ded1", QString(), 2, -5.0, 5.0);
-    add("ded2", QString(), 2, -5.0, 5.0);
-    add("eld1", QString(), 2, -5.0, 5.0);
-    add("eld2", QString(), 2, -5.0, 5.0);
-    add("eld3", QString(), 2, -5.0, 5.0);
-    add("eld4", QString(), 2, -5.0, 5.0);
-    add("eld5", QString(), 2, -5.0, 5.0);
-    add("fmsynth", QString(), 2, -5.0, 5.0);
-    add("gallagher101", QString(), 2, -5.0, 5.0);
-    add("gallagher21", QString(), 2, -5.0, 5.0);
-    add("heatexchanger", QString(), 2, -5.0, 5.0);
-
-    add("himmelblau",
-        QStringLiteral("(x0^2 + x1 - 11)^2 + (x0 + x1^2 - 7)^2"), 2, -5.0, 5.0);
-
-    add("hydrothermal", QString(), 2, -5.0, 5.0);
-    add("ik6dof", QString(), 2, -5.0, 5.0);
-    add("katsuura", QString(), 2, -5.0, 5.0);
-    add("lunacekbirastrigin", QString(), 2, -5.0, 5.0);
-    add("messenger", QString(), 2, -5.0, 5.0);
-
-    // Michalewicz (2D, m=10) - using a common 2D specialization
-    add("michalewicz",
-        QStringLiteral("-(sin(x0) * (sin(1*x0^2/pi))^20 + sin(x1) * (sin(2*x1^2/pi))^20)"), 2, 0.0, 3.141592653589793);
-
-    add("ofdmpower", QString(), 2, -5.0, 5.0);
-    add("polyphase", QString(), 2, -5.0, 5.0);
-    add("portfoliomv", QString(), 2, -5.0, 5.0);
-
-    // Schaffer N.2
-    add("schaffer",
-        QStringLiteral("0.5 + ((sin(x0^2 - x1^2))^2 - 0.5) / (1 + 0.001*(x0^2 + x1^2))^2"), 2, -100.0, 100.0);
-
-    // Schwefel 2.26 (2D specialization)
-    add("schwefel",
-        QStringLiteral("837.9658 - (x0*sin(sqrt(abs(x0))) + x1*sin(sqrt(abs(x1))))"), 2, -500.0, 500.0);
-
-    add("tandem", QString(), 2, -5.0, 5.0);
-    add("tersoffb", QString(), 2, -5.0, 5.0);
-    add("tersoffc", QString(), 2, -5.0, 5.0);
-    add("tnep", QString(), 2, -5.0, 5.0);
-    add("transmissionpricing", QString(), 2, -5.0, 5.0);
-    add("vibratingplatform", QString(), 2, -5.0, 5.0);
-    add("weierstrass", makeWeierstrass2D(), 2, -0.5, 0.5);
-    add("wirelesscoverage", QString(), 2, -5.0, 5.0);
-
-    add("zakharov",
-        QStringLiteral("x0^2 + x1^2 + (0.5*(1*x0 + 2*x1))^2 + (0.5*(1*x0 + 2*x1))^4"), 2, -5.0, 10.0);
-
-    add("sinusoidal", QString(), 2, -5.0, 5.0);
-    add("gascycle", QString(), 2, -5.0, 5.0);
-
-    add("gkls", QString(), 2, -1.0, 1.0);
-    add("gkls250", QString(), 2, -1.0, 1.0);
-    add("gkls350", QString(), 2, -1.0, 1.0);
-    add("gkls2100", QString(), 2, -1.0, 1.0);
+    presets_ = builtinPresets();
 
     presetBox_->blockSignals(true);
     presetBox_->clear();
-    for(const auto& p: presets_) presetBox_->addItem(p.name);
+    for(const auto& p: presets_) presetBox_->addItem(QString::fromStdString(p.name));
     presetBox_->blockSignals(false);
 }
 
@@ -424,7 +230,7 @@ void MainWindow::onPresetChanged(int idx)
     if(idx<0 || idx>=static_cast<int>(presets_.size())) return;
     const auto& p = presets_[static_cast<size_t>(idx)];
 
-    exprEdit_->setText(p.expr);
+    exprEdit_->setText(QString::fromStdString(p.expr));
     dimSpin_->setValue(p.dim);
 
     lower_.assign(p.dim, p.lo);
@@ -434,9 +240,9 @@ void MainWindow::onPresetChanged(int idx)
     refreshAxesCombos();
     refreshBoundsTable();
 
-    if(p.expr.trimmed().isEmpty()){
+    if(p.expr.empty()){
         setStatus(QString("Preset '%1' is a placeholder in standalone mode (no analytic expression). "
-                          "Enter an expression manually and click Apply / Rebuild.").arg(p.name));
+                          "Enter an expression manually and click Apply / Rebuild.").arg(QString::fromStdString(p.name)));
         return;
     }
 
@@ -471,6 +277,83 @@ void MainWindow::refreshAxesCombos()
     yAxisBox_->setCurrentIndex(d>1 ? 1 : 0);
     xAxisBox_->blockSignals(false);
     yAxisBox_->blockSignals(false);
+    refreshFixedSlider();
+}
+
+void MainWindow::refreshFixedSlider()
+{
+    const int xAxis = xAxisBox_->currentData().toInt();
+    const int yAxis = yAxisBox_->currentData().toInt();
+    fixedVarBox_->blockSignals(true);
+    fixedVarBox_->clear();
+    for(int i=0;i<dimSpin_->value();i++)
+        if(i!=xAxis && i!=yAxis) fixedVarBox_->addItem(QString("x%1").arg(i), i);
+    fixedVarBox_->blockSignals(false);
+
+    const bool any = fixedVarBox_->count() > 0;
+    fixedVarBox_->setEnabled(any);
+    fixedSlider_->setEnabled(any);
+    if(any) onFixedVarChanged(0);
+    else fixedLabel_->setText("Fixed value: all variables are axes");
+}
+
+void MainWindow::onFixedVarChanged(int)
+{
+    const int var = fixedVarBox_->currentData().toInt();
+    if(var<0 || var>=table_->rowCount() || !table_->item(var, 3)) return;
+    const double lo = table_->item(var,1)->text().toDouble();
+    const double hi = table_->item(var,2)->text().toDouble();
+    const double fx = table_->item(var,3)->text().toDouble();
+    const double t = hi>lo ? std::clamp((fx-lo)/(hi-lo), 0.0, 1.0) : 0.0;
+
+    fixedSlider_->blockSignals(true);
+    fixedSlider_->setValue(int(std::lround(t*kFixedSteps)));
+    fixedSlider_->blockSignals(false);
+    fixedLabel_->setText(QString("x%1 = %2").arg(var).arg(fx, 0, 'g', 6));
+}
+
+void MainWindow::onFixedSliderMoved(int v)
+{
+    const int var = fixedVarBox_->currentData().toInt();
+    if(var<0 || var>=table_->rowCount() || !table_->item(var, 3)) return;
+    bool ok1=false, ok2=false;
+    const double lo = table_->item(var,1)->text().toDouble(&ok1);
+    const double hi = table_->item(var,2)->text().toDouble(&ok2);
+    if(!ok1 || !ok2 || hi<=lo) return;
+
+    const double value = lo + (hi-lo)*double(v)/kFixedSteps;
+    table_->blockSignals(true);
+    table_->item(var,3)->setText(QString::number(value));
+    table_->blockSignals(false);
+    fixedLabel_->setText(QString("x%1 = %2").arg(var).arg(value, 0, 'g', 6));
+    scheduleRebuild();
+}
+
+void MainWindow::onTableItemChanged(QTableWidgetItem* item)
+{
+    if(item && item->row()==fixedVarBox_->currentData().toInt())
+        onFixedVarChanged(fixedVarBox_->currentIndex());
+    scheduleRebuild();
+}
+
+void MainWindow::scheduleRebuild()
+{
+    // Everything changed before the timer fires goes into one rebuild.
+    if(!editClock_.isValid()) editClock_.start();
+    if(!liveTimer_->isActive()) liveTimer_->start();
+}
+
+void MainWindow::onLiveTimeout()
+{
+    // Let a young rebuild finish instead of cancelling it; onRebuildFinished() or the next
+    // tick picks up the pending changes.
+    if(surface_->rebuildInFlight() && surface_->rebuildElapsedMs() < kLiveMaxWaitMs){
+        liveTimer_->start();
+        return;
+    }
+    liveWaitMs_ = double(editClock_.nsecsElapsed()) / 1e6;
+    editClock_.invalidate();
+    liveRebuild_ = applySettings(false);
 }
 
 void MainWindow::refreshBoundsTable()
@@ -480,6 +363,7 @@ void MainWindow::refreshBoundsTable()
     table_->setRowCount(d);
     for(int r=0;r<d;r++) setTableRow(r, r);
     table_->blockSignals(false);
+    onFixedVarChanged(fixedVarBox_->currentIndex());
 }
 
 void MainWindow::setTableRow(int row, int varIndex)
@@ -497,7 +381,8 @@ void MainWindow::setTableRow(int row, int varIndex)
     table_->setItem(row, 3, itFx);
 }
 
-bool MainWindow::readTableToVectors(std::vector<double>& lower, std::vector<double>& upper, std::vector<double>& fixed)
+bool MainWindow::readTableToVectors(std::vector<double>& lower, std::vector<double>& upper, std::vector<double>& fixed,
+                                    bool interactive)
 {
     const int d = dimSpin_->value();
     lower.assign(d, 0.0);
@@ -510,10 +395,12 @@ bool MainWindow::readTableToVectors(std::vector<double>& lower, std::vector<doub
         double hi = table_->item(r,2)->text().toDouble(&ok2);
         double fx = table_->item(r,3)->text().toDouble(&ok3);
         if(!ok1 || !ok2 || !ok3){
+            if(!interactive) return false;
             QMessageBox::warning(this, "Invalid input", QString("Row %1 contains invalid numeric values.").arg(r));
             return false;
         }
         if(hi<=lo){
+            if(!interactive) return false;
             QMessageBox::warning(this, "Invalid bounds", QString("Row %1: upper must be > lower.").arg(r));
             return false;
         }
@@ -527,12 +414,14 @@ bool MainWindow::readTableToVectors(std::vector<double>& lower, std::vector<doub
 void MainWindow::onAxesChanged()
 {
     // Rebuild immediately to make axis changes obvious.
+    refreshFixedSlider();
     onApply();
 }
 
 void MainWindow::onGridChanged(int)
 {
-    // no automatic rebuild here; keep it responsive for large grids
+    // Spinning through sizes is coalesced like any other live edit.
+    scheduleRebuild();
 }
 
 void MainWindow::onWireframeChanged(int)
@@ -541,6 +430,104 @@ void MainWindow::onWireframeChanged(int)
     surface_->update();
 }
 
+void MainWindow::onHeightmapChanged(int)
+{
+    const bool on = heightmapCheck_->isChecked();
+    gridSpin_->setRange(21, on ? 4097 : 401);
+    surface_->setHeightmapMode(on);
+    onApply();
+}
+
+void MainWindow::onAdaptiveChanged(int)
+{
+    // The adaptive mesh has no grid layout to put into a height texture.
+    const bool on = adaptiveCheck_->isChecked();
+    if(on) heightmapCheck_->setChecked(false);
+    heightmapCheck_->setEnabled(!on);
+    surface_->setAdaptiveSampling(on);
+    onApply();
+}
+
+void MainWindow::onCompactChanged(int)
+{
+    surface_->setCompactVertices(compactCheck_->isChecked());
+    onApply();
+}
+
+void MainWindow::onExactNormalsChanged(int)
+{
+    surface_->setExactNormals(exactNormalsCheck_->isChecked());
+    onApply();
+}
+
+void MainWindow::onStripsChanged(int)
+{
+    surface_->setStripIndices(stripCheck_->isChecked());
+    surface_->update();
+}
+
+void MainWindow::onContoursChanged(int levels)
+{
+    // A cached slice only needs meshing and contouring again.
+    surface_->setContourLevels(levels);
+    scheduleRebuild();
+}
+
+void MainWindow::onTopViewChanged(int)
+{
+    surface_->setTopView(topViewCheck_->isChecked());
+    surface_->update();
+}
+
+void MainWindow::onHeatmapPanelChanged(int)
+{
+    plot_->setVisible(heatmapPanelCheck_->isChecked());
+    refreshHeatmap();
+}
+
+void MainWindow::refreshHeatmap()
+{
+    if(!plot_->isVisible()) return;
+    SurfaceWidget::SampledSlice slice = surface_->sampledSlice();
+    if(!slice.grid){
+        plot_->clear();
+        return;
+    }
+    const size_t ax = static_cast<size_t>(slice.spec.xAxis), ay = static_cast<size_t>(slice.spec.yAxis);
+    plot_->setHeatmapData(std::move(slice.grid),
+                          slice.spec.lower[ax], slice.spec.upper[ax], slice.spec.lower[ay], slice.spec.upper[ay],
+                          QString("x%1").arg(slice.spec.xAxis), QString("x%1").arg(slice.spec.yAxis),
+                          QString("f(x%1, x%2)").arg(slice.spec.xAxis).arg(slice.spec.yAxis));
+}
+
+void MainWindow::onCacheBudgetChanged(int mb)
+{
+    surface_->setSliceCacheBudget(std::size_t(mb) << 20);
+}
+
+void MainWindow::onDiskCacheChanged(int)
+{
+    const QString dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/slices";
+    surface_->setSliceStore(diskCacheCheck_->isChecked() ? dir.toStdString() : std::string());
+}
+
+void MainWindow::onGpuFrameTimed(double ms)
+{
+    gpuLabel_->setText(QString("GPU draw: %1 ms").arg(ms, 0, 'f', 3));
+}
+
+void MainWindow::onMinimumBounded(double lower, double upper, double x, double y, bool converged)
+{
+    if(!std::isfinite(upper)){
+        minimumLabel_->setText("Minimum: f has no finite value on this slice");
+        return;
+    }
+    // The search stops early on a budget; the bracket holds either way.
+    minimumLabel_->setText(QString("Minimum: %1 at (%2, %3), certified ≥ %4%5")
+                               .arg(upper, 0, 'g', 8).arg(x, 0, 'g', 6).arg(y, 0, 'g', 6)
+                               .arg(lower, 0, 'g', 8).arg(converged ? "" : " (search budget reached)"));
+}
+
 void MainWindow::onZScaleChanged(int v)
 {
     const double s = static_cast<double>(v)/100.0;
@@ -550,29 +537,40 @@ void MainWindow::onZScaleChanged(int v)
 }
 
 void MainWindow::onApply()
+{
+    // An explicit rebuild supersedes pending live edits.
+    liveTimer_->stop();
+    editClock_.invalidate();
+    liveRebuild_ = false;
+    applySettings(true);
+}
+
+bool MainWindow::applySettings(bool interactive)
 {
     const QString exprText = exprEdit_->text().trimmed();
     if(exprText.isEmpty()){
-        setStatus("No expression to evaluate. Select an analytic preset or enter an expression manually.");
-        return;
+        if(interactive) setStatus("No expression to evaluate. Select an analytic preset or enter an expression manually.");
+        return false;
     }
 
+    // Live updates keep the compiled expression unless it was edited.
     const int d = dimSpin_->value();
+    const std::string expr = exprText.toStdString();
     std::string err;
-    if(!obj_.setExpression(exprText.toStdString(), d, &err)){
-        QMessageBox::critical(this, "Expression error", QString::fromStdString(err));
-        return;
+    if((interactive || expr!=obj_.expression() || d!=obj_.dimension()) && !obj_.setExpression(expr, d, &err)){
+        if(interactive) QMessageBox::critical(this, "Expression error", QString::fromStdString(err));
+        return false;
     }
 
     std::vector<double> lo, hi, fx;
-    if(!readTableToVectors(lo, hi, fx)) return;
+    if(!readTableToVectors(lo, hi, fx, interactive)) return false;
     lower_ = lo; upper_ = hi; fixed_ = fx;
 
     const int xAxis = xAxisBox_->currentData().toInt();
     const int yAxis = yAxisBox_->currentData().toInt();
     if(xAxis==yAxis){
-        QMessageBox::warning(this, "Axes", "X axis and Y axis must be different.");
-        return;
+        if(interactive) QMessageBox::warning(this, "Axes", "X axis and Y axis must be different.");
+        return false;
     }
 
     surface_->setObjective(obj_);
@@ -584,8 +582,64 @@ void MainWindow::onApply()
     surface_->setWireframe(wireCheck_->isChecked());
     surface_->rebuildSurface();
 
-    setStatus(QString("Rendering %1×%1 grid. Axes: x%2 vs x%3.")
-                  .arg(gridSpin_->value()).arg(xAxis).arg(yAxis));
+    if(interactive){
+        setStatus(QString("Rendering %1×%1 grid. Axes: x%2 vs x%3.")
+                      .arg(gridSpin_->value()).arg(xAxis).arg(yAxis));
+    }
+    return true;
+}
+
+static QString memoryText(const SurfaceWidget::MemoryStats& m)
+{
+    const auto mb = [](qint64 bytes){ return QString::number(double(bytes)/(1024.0*1024.0), 'f', 2); };
+    QString s = QString(" GPU: %1 MB vertices, %2 MB indices").arg(mb(m.vertexBytes)).arg(mb(m.indexBytes));
+    if(m.textureBytes) s += QString(", %1 MB heights").arg(mb(m.textureBytes));
+    return s + ".";
+}
+
+static QString cacheText(const SliceCache::Stats& c)
+{
+    return QString(" Slice cache: %1 hits, %2 from disk, %3 misses, %4 grids (%5 MB).")
+        .arg(qulonglong(c.hits)).arg(qulonglong(c.diskHits)).arg(qulonglong(c.misses)).arg(qulonglong(c.entries))
+        .arg(QString::number(double(c.bytes)/(1024.0*1024.0), 'f', 1));
+}
+
+void MainWindow::onRebuildFinished(int gridN, double firstLevelMs, double totalMs)
+{
+    refreshHeatmap();
+
+    QString live;
+    if(liveRebuild_){
+        // Latency from the first coalesced edit to the finished surface; the rate is smoothed
+        // over consecutive live updates.
+        const double latency = liveWaitMs_ + totalMs;
+        if(liveClock_.isValid() && liveClock_.elapsed() < 1000){
+            const double rate = 1000.0 / std::max<qint64>(1, liveClock_.elapsed());
+            liveRate_ = liveRate_ > 0.0 ? 0.8*liveRate_ + 0.2*rate : rate;
+        } else {
+            liveRate_ = 0.0;
+        }
+        liveClock_.start();
+        live = QString(" Live update: %1 ms after the edit").arg(latency, 0, 'f', 1);
+        if(liveRate_ > 0.0) live += QString(", %1 updates/s").arg(liveRate_, 0, 'f', 1);
+        live += ".";
+    }
+
+    const QString what = adaptiveCheck_->isChecked()
+        ? QString("adaptive %1×%1 surface (%2 evaluations)").arg(gridN).arg(qulonglong(surface_->evaluations()))
+        : QString("%1×%1 grid").arg(gridN);
+    setStatus(QString("Rendered %1 in %2 ms (first preview after %3 ms). Axes: x%4 vs x%5. Program: %6 → %7 instructions, %8 shared subexpressions.")
+                  .arg(what).arg(totalMs, 0, 'f', 1).arg(firstLevelMs, 0, 'f', 1)
+                  .arg(xAxisBox_->currentData().toInt()).arg(yAxisBox_->currentData().toInt())
+                  .arg(obj_.unoptimizedSize()).arg(obj_.programSize()).arg(obj_.sharedSubexpressions())
+              + live + memoryText(surface_->memoryStats()) + cacheText(surface_->sliceCacheStats()));
+
+    // Edits that arrived while this rebuild ran go out now rather than on the next tick.
+    // This comes last: it restarts the live latency and applies the new settings.
+    if(editClock_.isValid()){
+        liveTimer_->stop();
+        onLiveTimeout();
+    }
 }
 
 void MainWindow::setStatus(const QString& s)
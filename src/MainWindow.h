@@ -8,8 +8,12 @@
 #include <QSlider>
 #include <QLabel>
 #include <QPushButton>
+#include <QTimer>
+#include <QElapsedTimer>
 #include "SurfaceWidget.h"
+#include "PlotWidget.h"
 #include "ObjectiveFunction.h"
+#include "Presets.h"
 
 class MainWindow : public QMainWindow
 {
@@ -22,9 +26,26 @@ private slots:
     void onDimensionChanged(int v);
     void onAxesChanged();
     void onApply();
+    void onTableItemChanged(QTableWidgetItem* item);
+    void onFixedVarChanged(int idx);
+    void onFixedSliderMoved(int v);
+    void onLiveTimeout();
     void onWireframeChanged(int state);
+    void onHeightmapChanged(int state);
+    void onAdaptiveChanged(int state);
+    void onCompactChanged(int state);
+    void onExactNormalsChanged(int state);
+    void onStripsChanged(int state);
+    void onContoursChanged(int levels);
+    void onTopViewChanged(int state);
+    void onHeatmapPanelChanged(int state);
+    void onCacheBudgetChanged(int mb);
+    void onDiskCacheChanged(int state);
+    void onGpuFrameTimed(double ms);
+    void onMinimumBounded(double lower, double upper, double x, double y, bool converged);
     void onGridChanged(int v);
     void onZScaleChanged(int v);
+    void onRebuildFinished(int gridN, double firstLevelMs, double totalMs);
 
 private:
     void buildUi();
@@ -32,13 +53,20 @@ private:
     void refreshAxesCombos();
     void refreshBoundsTable();
     void setTableRow(int row, int varIndex);
-    bool readTableToVectors(std::vector<double>& lower, std::vector<double>& upper, std::vector<double>& fixed);
+    void refreshFixedSlider();
+    // Warnings are shown in message boxes only if interactive; live updates skip bad input.
+    bool readTableToVectors(std::vector<double>& lower, std::vector<double>& upper, std::vector<double>& fixed,
+                            bool interactive = true);
+    bool applySettings(bool interactive);
+    void scheduleRebuild();
     void setStatus(const QString& s);
+    // Points the heatmap panel (if shown) at the grid behind the current surface.
+    void refreshHeatmap();
 
-    struct Preset { QString name; QString expr; int dim; double lo; double hi; };
     std::vector<Preset> presets_;
 
     SurfaceWidget* surface_{nullptr};
+    PlotWidget* plot_{nullptr};
 
     QComboBox* presetBox_{nullptr};
     QLineEdit* exprEdit_{nullptr};
@@ -47,11 +75,39 @@ private:
     QComboBox* yAxisBox_{nullptr};
     QSpinBox* gridSpin_{nullptr};
     QCheckBox* wireCheck_{nullptr};
+    QCheckBox* heightmapCheck_{nullptr};
+    QCheckBox* adaptiveCheck_{nullptr};
+    QCheckBox* compactCheck_{nullptr};
+    QCheckBox* exactNormalsCheck_{nullptr};
+    QCheckBox* stripCheck_{nullptr};
+    QSpinBox* contourSpin_{nullptr};
+    QCheckBox* topViewCheck_{nullptr};
+    QCheckBox* heatmapPanelCheck_{nullptr};
+    QLabel* gpuLabel_{nullptr};
+    QLabel* minimumLabel_{nullptr};
+    QSpinBox* cacheSpin_{nullptr};
+    QCheckBox* diskCacheCheck_{nullptr};
     QSlider* zScale_{nullptr};
     QLabel* zScaleLabel_{nullptr};
+    QComboBox* fixedVarBox_{nullptr};
+    QSlider* fixedSlider_{nullptr};
+    QLabel* fixedLabel_{nullptr};
     QTableWidget* table_{nullptr};
     QPushButton* applyBtn_{nullptr};
 
+    // Live updates: edits are coalesced into at most one rebuild per frame (liveTimer_).
+    // A running rebuild younger than kLiveMaxWaitMs is left to finish; older ones are
+    // replaced by the newer request.
+    static constexpr int kLiveFrameMs = 16;
+    static constexpr double kLiveMaxWaitMs = 100.0;
+    static constexpr int kFixedSteps = 1000;
+    QTimer* liveTimer_{nullptr};
+    QElapsedTimer editClock_;       // since the first edit not yet handed to a rebuild
+    QElapsedTimer liveClock_;       // since the last live update was shown
+    double liveWaitMs_{0.0};
+    double liveRate_{0.0};
+    bool liveRebuild_{false};
+
     ObjectiveFunction obj_;
     std::vector<double> lower_, upper_, fixed_;
 };
@@ -1,11 +1,20 @@
 #include "ObjectiveFunction.h"
+#include "Jit.h"
 #include <cctype>
 #include <cmath>
+#include <cstring>
 #include <stack>
+#include <algorithm>
 #include <unordered_map>
 #include <sstream>
 #include <limits>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
 static bool isIdentChar(char c)
 {
     return std::isalpha(static_cast<unsigned char>(c)) || std::isdigit(static_cast<unsigned char>(c)) || c=='_';
@@ -16,6 +25,14 @@ bool ObjectiveFunction::setExpression(const std::string& expr, int dimension, st
     expr_ = expr;
     dim_ = dimension;
     rpn_.clear();
+    code_.clear();
+    maxStack_ = 0;
+    numRegs_ = 0;
+    shared_ = 0;
+    dag_.clear();
+    root_ = -1;
+    jit_.reset();
+    nativeFn_ = native_ = nullptr;
 
     if (dim_ <= 0) {
         if (errorMsg) *errorMsg = "Dimension must be >= 1.";
@@ -30,11 +47,26 @@ bool ObjectiveFunction::setExpression(const std::string& expr, int dimension, st
 
     if (!bindFunctions(rpn, errorMsg)) return false;
 
+    Dag dag;
+    int root=-1;
+    if (!buildDag(rpn, dag, root, errorMsg)) return false;
+    if (!compile(dag.nodes, root, errorMsg)) return false;
+    shared_ = dag.shared;
+    dag_ = std::move(dag.nodes);
+    root_ = root;
+
     rpn_ = std::move(rpn);
+    compileNative();
     return true;
 }
 
 double ObjectiveFunction::evaluate(const std::vector<double>& x) const
+{
+    if (static_cast<int>(x.size()) != dim_) return std::numeric_limits<double>::quiet_NaN();
+    return run(x.data());
+}
+
+double ObjectiveFunction::evaluateReference(const std::vector<double>& x) const
 {
     if (static_cast<int>(x.size()) != dim_) return std::numeric_limits<double>::quiet_NaN();
     return evalRPN(x);
@@ -246,30 +278,31 @@ bool ObjectiveFunction::bindFunctions(std::vector<Token>& rpn, std::string* err)
 {
     auto setErr=[&](const std::string& m){ if(err) *err=m; };
 
-    // Map function name -> arity + function pointers
+    // Map function name -> arity + opcode + function pointers
     struct FnDef {
         int arity;
+        Op op;
         std::function<double(double)> fn1;
         std::function<double(double,double)> fn2;
     };
 
     const std::unordered_map<std::string, FnDef> fns = {
-        {"sin",   {1, [](double a){ return std::sin(a); }, {}}},
-        {"cos",   {1, [](double a){ return std::cos(a); }, {}}},
-        {"tan",   {1, [](double a){ return std::tan(a); }, {}}},
-        {"asin",  {1, [](double a){ return std::asin(a); }, {}}},
-        {"acos",  {1, [](double a){ return std::acos(a); }, {}}},
-        {"atan",  {1, [](double a){ return std::atan(a); }, {}}},
-        {"exp",   {1, [](double a){ return std::exp(a); }, {}}},
-        {"log",   {1, [](double a){ return std::log(a); }, {}}},
-        {"log10", {1, [](double a){ return std::log10(a); }, {}}},
-        {"sqrt",  {1, [](double a){ return std::sqrt(a); }, {}}},
-        {"abs",   {1, [](double a){ return std::fabs(a); }, {}}},
-        {"floor", {1, [](double a){ return std::floor(a); }, {}}},
-        {"ceil",  {1, [](double a){ return std::ceil(a); }, {}}},
-        {"min",   {2, {}, [](double a,double b){ return (a<b)?a:b; }}},
-        {"max",   {2, {}, [](double a,double b){ return (a>b)?a:b; }}},
-        {"pow",   {2, {}, [](double a,double b){ return std::pow(a,b); }}},
+        {"sin",   {1, Op::Sin,   [](double a){ return std::sin(a); }, {}}},
+        {"cos",   {1, Op::Cos,   [](double a){ return std::cos(a); }, {}}},
+        {"tan",   {1, Op::Tan,   [](double a){ return std::tan(a); }, {}}},
+        {"asin",  {1, Op::Asin,  [](double a){ return std::asin(a); }, {}}},
+        {"acos",  {1, Op::Acos,  [](double a){ return std::acos(a); }, {}}},
+        {"atan",  {1, Op::Atan,  [](double a){ return std::atan(a); }, {}}},
+        {"exp",   {1, Op::Exp,   [](double a){ return std::exp(a); }, {}}},
+        {"log",   {1, Op::Log,   [](double a){ return std::log(a); }, {}}},
+        {"log10", {1, Op::Log10, [](double a){ return std::log10(a); }, {}}},
+        {"sqrt",  {1, Op::Sqrt,  [](double a){ return std::sqrt(a); }, {}}},
+        {"abs",   {1, Op::Abs,   [](double a){ return std::fabs(a); }, {}}},
+        {"floor", {1, Op::Floor, [](double a){ return std::floor(a); }, {}}},
+        {"ceil",  {1, Op::Ceil,  [](double a){ return std::ceil(a); }, {}}},
+        {"min",   {2, Op::Min,   {}, [](double a,double b){ return (a<b)?a:b; }}},
+        {"max",   {2, Op::Max,   {}, [](double a,double b){ return (a>b)?a:b; }}},
+        {"pow",   {2, Op::Pow,   {}, [](double a,double b){ return std::pow(a,b); }}},
     };
 
     for(auto& t : rpn){
@@ -281,6 +314,7 @@ bool ObjectiveFunction::bindFunctions(std::vector<Token>& rpn, std::string* err)
             return false;
         }
         t.funcArity = it->second.arity;
+        t.fnOp = it->second.op;
         t.fn1 = it->second.fn1;
         t.fn2 = it->second.fn2;
     }
@@ -336,3 +370,1227 @@ double ObjectiveFunction::evalRPN(const std::vector<double>& x) const
     if(st.size()!=1) return std::numeric_limits<double>::quiet_NaN();
     return st.back();
 }
+
+
+int ObjectiveFunction::arity(Op op)
+{
+    switch(op){
+        case Op::Const: case Op::Var: case Op::Load: case Op::Store: return 0;
+        case Op::Add: case Op::Sub: case Op::Mul: case Op::Div: case Op::Pow:
+        case Op::Min: case Op::Max: return 2;
+        default: return 1;
+    }
+}
+
+// Scalar semantics of every opcode; shared by the constant folder so folded values are
+// exactly what run() would have produced at each grid point.
+double ObjectiveFunction::applyOp(Op op, double a, double b)
+{
+    switch(op){
+        case Op::Add: return a + b;
+        case Op::Sub: return a - b;
+        case Op::Mul: return a * b;
+        case Op::Div: return a / b;
+        case Op::Pow: return std::pow(a, b);
+        case Op::Min: return (a<b) ? a : b;
+        case Op::Max: return (a>b) ? a : b;
+        case Op::Sin:   return std::sin(a);
+        case Op::Cos:   return std::cos(a);
+        case Op::Tan:   return std::tan(a);
+        case Op::Asin:  return std::asin(a);
+        case Op::Acos:  return std::acos(a);
+        case Op::Atan:  return std::atan(a);
+        case Op::Exp:   return std::exp(a);
+        case Op::Log:   return std::log(a);
+        case Op::Log10: return std::log10(a);
+        case Op::Sqrt:  return std::sqrt(a);
+        case Op::Abs:   return std::fabs(a);
+        case Op::Floor: return std::floor(a);
+        case Op::Ceil:  return std::ceil(a);
+        case Op::Neg:   return 0.0 - a;
+        case Op::Sqr:   return a * a;
+        case Op::Cube:  return (a * a) * a;
+        case Op::Const: case Op::Var: case Op::Store: case Op::Load: break;
+    }
+    return std::numeric_limits<double>::quiet_NaN();
+}
+
+int ObjectiveFunction::intern(Dag& dag, const Node& n)
+{
+    std::uint64_t bits=0;
+    static_assert(sizeof(bits)==sizeof(n.value), "double must be 64-bit");
+    std::memcpy(&bits, &n.value, sizeof(bits));
+
+    const auto key = std::make_tuple(n.op, n.a, n.b, n.var, bits);
+    const auto it = dag.index.find(key);
+    if(it!=dag.index.end()){
+        if(arity(n.op)>0) dag.shared++;
+        return it->second;
+    }
+    dag.nodes.push_back(n);
+    const int idx = static_cast<int>(dag.nodes.size())-1;
+    dag.index.emplace(key, idx);
+    return idx;
+}
+
+int ObjectiveFunction::makeNode(Dag& dag, Op op, int a, int b)
+{
+    std::vector<Node>& nodes = dag.nodes;
+    auto isConst=[&](int i){ return i>=0 && nodes[static_cast<size_t>(i)].op==Op::Const; };
+    auto constIs=[&](int i, double v){ return isConst(i) && nodes[static_cast<size_t>(i)].value==v; };
+    auto push=[&](const Node& n)->int{ return intern(dag, n); };
+
+    const int n = arity(op);
+
+    // Fold variable-free subtrees.
+    if(isConst(a) && (n==1 || isConst(b))){
+        Node c; c.op=Op::Const;
+        c.value = applyOp(op, nodes[static_cast<size_t>(a)].value, n==2 ? nodes[static_cast<size_t>(b)].value : 0.0);
+        return push(c);
+    }
+
+    // Algebraic rewrites. Each one computes the same value as the original for every
+    // input (up to rounding for the expanded powers), so no reassociation is done.
+    switch(op){
+        case Op::Sub:
+            if(constIs(b, 0.0)) return a;
+            if(constIs(a, 0.0)) return makeNode(dag, Op::Neg, b, -1);   // unary minus
+            break;
+        case Op::Mul:
+            if(constIs(b, 1.0)) return a;
+            if(constIs(a, 1.0)) return b;
+            break;
+        case Op::Div:
+            if(constIs(b, 1.0)) return a;
+            break;
+        case Op::Neg:
+            // 0 - (0 - x) is x for every x except -0.
+            if(nodes[static_cast<size_t>(a)].op==Op::Neg) return nodes[static_cast<size_t>(a)].a;
+            break;
+        case Op::Pow:
+            if(isConst(b)){
+                const double e = nodes[static_cast<size_t>(b)].value;
+                if(e==1.0) return a;
+                if(e==2.0) return makeNode(dag, Op::Sqr, a, -1);
+                if(e==3.0) return makeNode(dag, Op::Cube, a, -1);
+                if(e==4.0) return makeNode(dag, Op::Sqr, makeNode(dag, Op::Sqr, a, -1), -1);
+                if(e==0.5) return makeNode(dag, Op::Sqrt, a, -1);
+                if(e==0.0){ Node c; c.op=Op::Const; c.value=1.0; return push(c); }
+                if(e==-1.0){
+                    Node one; one.op=Op::Const; one.value=1.0;
+                    return makeNode(dag, Op::Div, push(one), a);
+                }
+            }
+            break;
+        default:
+            break;
+    }
+
+    // a+b and a*b are exactly commutative; order the operands so both spellings merge.
+    if((op==Op::Add || op==Op::Mul) && b<a) std::swap(a, b);
+
+    Node node; node.op=op; node.a=a; node.b=b;
+    return push(node);
+}
+
+bool ObjectiveFunction::buildDag(const std::vector<Token>& rpn, Dag& dag, int& root, std::string* err)
+{
+    auto setErr=[&](const std::string& m){ if(err) *err=m; };
+
+    dag = Dag{};
+    dag.nodes.reserve(rpn.size()*2);
+    std::vector<int> st;
+
+    for(const auto& t : rpn){
+        Op op;
+        if(t.type==TokType::Number){
+            Node c; c.op=Op::Const; c.value=t.number;
+            st.push_back(intern(dag, c));
+            continue;
+        } else if(t.type==TokType::Var){
+            Node v; v.op=Op::Var; v.var=t.varIndex;
+            st.push_back(intern(dag, v));
+            continue;
+        } else if(t.type==TokType::Op){
+            switch(t.op){
+                case '+': op=Op::Add; break;
+                case '-': op=Op::Sub; break;
+                case '*': op=Op::Mul; break;
+                case '/': op=Op::Div; break;
+                case '^': op=Op::Pow; break;
+                default: setErr("Unknown operator."); return false;
+            }
+        } else if(t.type==TokType::Func){
+            op=t.fnOp;
+        } else {
+            setErr("Mismatched parentheses.");
+            return false;
+        }
+
+        const int pops = arity(op);
+        if(static_cast<int>(st.size())<pops){
+            setErr("Malformed expression: missing operand.");
+            return false;
+        }
+        int a=-1, b=-1;
+        if(pops==2){ b=st.back(); st.pop_back(); }
+        a=st.back(); st.pop_back();
+        st.push_back(makeNode(dag, op, a, b));
+    }
+
+    if(st.size()!=1){
+        setErr(st.empty() ? "Empty expression." : "Malformed expression: missing operator or comma.");
+        return false;
+    }
+    root = st.back();
+    return true;
+}
+
+int ObjectiveFunction::rebuild(const std::vector<Node>& src, int root, Dag& out, const std::function<int(int)>& replace)
+{
+    const size_t count = static_cast<size_t>(root) + 1;
+    std::vector<char> reach(count, 0);
+    std::vector<int> map(count, -1);
+    reach[count-1] = 1;
+
+    // Operands precede their users, so a descending sweep sees every parent first.
+    for(size_t i=count; i-->0;){
+        if(!reach[i]) continue;
+        map[i] = replace(static_cast<int>(i));
+        if(map[i]>=0) continue;
+        if(src[i].a>=0) reach[static_cast<size_t>(src[i].a)] = 1;
+        if(src[i].b>=0) reach[static_cast<size_t>(src[i].b)] = 1;
+    }
+    for(size_t i=0; i<count; i++){
+        if(!reach[i] || map[i]>=0) continue;
+        const Node& nd = src[i];
+        if(arity(nd.op)==0) map[i] = intern(out, nd);
+        else map[i] = makeNode(out, nd.op, map[static_cast<size_t>(nd.a)], nd.b>=0 ? map[static_cast<size_t>(nd.b)] : -1);
+    }
+    return map[count-1];
+}
+
+ObjectiveFunction ObjectiveFunction::fromDag(Dag&& dag, int root, int dim, const std::string& expr)
+{
+    ObjectiveFunction f;
+    f.dim_ = dim;
+    f.expr_ = expr;
+    // Specialisation only removes nodes, so this cannot exceed the limits the source passed.
+    if(f.compile(dag.nodes, root, nullptr)){
+        f.shared_ = dag.shared;
+        f.dag_ = std::move(dag.nodes);
+        f.root_ = root;
+        f.compileNative();
+    }
+    return f;
+}
+
+SlicePlan ObjectiveFunction::specializeSlice(int xVar, int yVar, const std::vector<double>& fixed) const
+{
+    SlicePlan plan;
+    if(root_<0) return plan;
+
+    // Substitute: x -> x0, y -> x1, everything else -> its fixed value. makeNode() then
+    // folds whatever no longer depends on x or y.
+    Dag sub;
+    const int subRoot = rebuild(dag_, root_, sub, [&](int i){
+        const Node& nd = dag_[static_cast<size_t>(i)];
+        if(nd.op!=Op::Var) return -1;
+        Node leaf;
+        if(nd.var==xVar){ leaf.op=Op::Var; leaf.var=0; }
+        else if(nd.var==yVar){ leaf.op=Op::Var; leaf.var=1; }
+        else {
+            leaf.op=Op::Const;
+            leaf.value = (nd.var>=0 && static_cast<size_t>(nd.var)<fixed.size()) ? fixed[static_cast<size_t>(nd.var)] : 0.0;
+        }
+        return intern(sub, leaf);
+    });
+
+    // Dependency mask per node: bit 0 = x, bit 1 = y.
+    std::vector<std::uint8_t> mask(sub.nodes.size(), 0);
+    for(size_t i=0;i<sub.nodes.size();i++){
+        const Node& nd = sub.nodes[i];
+        if(nd.op==Op::Var) mask[i] = static_cast<std::uint8_t>(1u << nd.var);
+        else {
+            if(nd.a>=0) mask[i] |= mask[static_cast<size_t>(nd.a)];
+            if(nd.b>=0) mask[i] |= mask[static_cast<size_t>(nd.b)];
+        }
+    }
+
+    // Every x-only or y-only operator node reached from the root through nodes that
+    // depend on both is a largest such subtree: hoist it into a term.
+    std::vector<int> termOf(sub.nodes.size(), -1);
+    Dag top;
+    const int topRoot = rebuild(sub.nodes, subRoot, top, [&](int i){
+        const size_t u = static_cast<size_t>(i);
+        const Node& nd = sub.nodes[u];
+        if(arity(nd.op)==0 || (mask[u]!=1 && mask[u]!=2)) return -1;
+
+        if(termOf[u]<0){
+            const int axis = (mask[u]==1) ? 0 : 1;
+            Dag t;
+            const int tRoot = rebuild(sub.nodes, i, t, [&](int k){
+                const Node& leaf = sub.nodes[static_cast<size_t>(k)];
+                if(leaf.op!=Op::Var) return -1;
+                Node v; v.op=Op::Var; v.var=0;
+                return intern(t, v);
+            });
+            termOf[u] = static_cast<int>(plan.terms.size());
+            plan.terms.push_back(fromDag(std::move(t), tRoot, 1, std::string()));
+            plan.termAxis.push_back(axis);
+        }
+        Node v; v.op=Op::Var; v.var=2 + termOf[u];
+        return intern(top, v);
+    });
+
+    plan.main = fromDag(std::move(top), topRoot, 2 + static_cast<int>(plan.terms.size()), expr_);
+    return plan;
+}
+
+IncrementalPlan ObjectiveFunction::specializeIncremental(int xVar, int yVar, int var, const std::vector<double>& fixed) const
+{
+    IncrementalPlan plan;
+    if(root_<0) return plan;
+
+    // Substitute: x -> x0, y -> x1, v -> x2, everything else -> its fixed value.
+    Dag sub;
+    const int subRoot = rebuild(dag_, root_, sub, [&](int i){
+        const Node& nd = dag_[static_cast<size_t>(i)];
+        if(nd.op!=Op::Var) return -1;
+        Node leaf;
+        if(nd.var==xVar){ leaf.op=Op::Var; leaf.var=0; }
+        else if(nd.var==yVar){ leaf.op=Op::Var; leaf.var=1; }
+        else if(nd.var==var){ leaf.op=Op::Var; leaf.var=2; }
+        else {
+            leaf.op=Op::Const;
+            leaf.value = (nd.var>=0 && static_cast<size_t>(nd.var)<fixed.size()) ? fixed[static_cast<size_t>(nd.var)] : 0.0;
+        }
+        return intern(sub, leaf);
+    });
+
+    // Dependency mask per node: bit 0 = x, bit 1 = y, bit 2 = v. Nodes appended to `sub`
+    // later are added by the same rule.
+    std::vector<std::uint8_t> mask;
+    auto updateMask = [&]{
+        for(size_t i=mask.size();i<sub.nodes.size();i++){
+            const Node& nd = sub.nodes[i];
+            std::uint8_t m = 0;
+            if(nd.op==Op::Var) m = static_cast<std::uint8_t>(1u << nd.var);
+            else {
+                if(nd.a>=0) m |= mask[static_cast<size_t>(nd.a)];
+                if(nd.b>=0) m |= mask[static_cast<size_t>(nd.b)];
+            }
+            mask.push_back(m);
+        }
+    };
+    updateMask();
+
+    // A sum at the top is flattened and regrouped as p + g(v): all addends that do not
+    // depend on v (constants included) are summed first, so they become a single part and
+    // `top` only adds the v-dependent ones to it. This reassociates the sum.
+    int root = subRoot;
+    if(mask[static_cast<size_t>(root)] & 4){
+        std::vector<std::pair<int, bool>> addends;   // node, negated
+        std::vector<std::pair<int, bool>> todo{{root, false}};
+        while(!todo.empty()){
+            const auto [i, neg] = todo.back();
+            todo.pop_back();
+            const Node& nd = sub.nodes[static_cast<size_t>(i)];
+            if(!(mask[static_cast<size_t>(i)] & 4)) addends.push_back({i, neg});
+            else if(nd.op==Op::Add || nd.op==Op::Sub){
+                todo.push_back({nd.b, nd.op==Op::Sub ? !neg : neg});
+                todo.push_back({nd.a, neg});
+            }
+            else if(nd.op==Op::Neg) todo.push_back({nd.a, !neg});
+            else addends.push_back({i, neg});
+        }
+
+        const auto fixedEnd = std::stable_partition(addends.begin(), addends.end(), [&](const std::pair<int, bool>& t){
+            return !(mask[static_cast<size_t>(t.first)] & 4);
+        });
+        if(fixedEnd != addends.begin() && addends.size() > 1){
+            int sum = -1;
+            for(const auto& [i, neg] : addends){
+                if(sum<0) sum = neg ? makeNode(sub, Op::Neg, i, -1) : i;
+                else sum = makeNode(sub, neg ? Op::Sub : Op::Add, sum, i);
+            }
+            root = sum;
+            updateMask();
+        }
+    }
+
+    // Every node reached from the root through v-dependent nodes that depends on x or y but
+    // not on v is a largest such subtree: it becomes a part.
+    std::vector<int> partOf(sub.nodes.size(), -1);
+    Dag top;
+    const int topRoot = rebuild(sub.nodes, root, top, [&](int i){
+        const size_t u = static_cast<size_t>(i);
+        Node v; v.op=Op::Var;
+        if(mask[u]==4){ v.var=0; return sub.nodes[u].op==Op::Var ? intern(top, v) : -1; }
+        if(mask[u]==0 || (mask[u] & 4)) return -1;
+
+        if(partOf[u]<0){
+            Dag p;
+            const int pRoot = rebuild(sub.nodes, i, p, [](int){ return -1; });
+            partOf[u] = static_cast<int>(plan.parts.size());
+            plan.parts.push_back(fromDag(std::move(p), pRoot, 2, std::string()));
+        }
+        v.var = 1 + partOf[u];
+        return intern(top, v);
+    });
+
+    plan.top = fromDag(std::move(top), topRoot, 1 + static_cast<int>(plan.parts.size()), expr_);
+    return plan;
+}
+
+ObjectiveFunction ObjectiveFunction::bindVariable(int var, double value) const
+{
+    if(root_<0) return *this;
+    Dag sub;
+    const int subRoot = rebuild(dag_, root_, sub, [&](int i){
+        const Node& nd = dag_[static_cast<size_t>(i)];
+        if(nd.op!=Op::Var || nd.var!=var) return -1;
+        Node leaf;
+        leaf.op = Op::Const;
+        leaf.value = value;
+        return intern(sub, leaf);
+    });
+    return fromDag(std::move(sub), subRoot, dim_, expr_);
+}
+
+std::uint64_t ObjectiveFunction::fingerprint() const
+{
+    // FNV-1a over the fields of every instruction (not the padded structs).
+    std::uint64_t h = 1469598103934665603ull;
+    auto mix = [&h](const void* p, std::size_t n){
+        const unsigned char* c = static_cast<const unsigned char*>(p);
+        for(std::size_t k=0;k<n;k++){ h ^= c[k]; h *= 1099511628211ull; }
+    };
+    mix(&dim_, sizeof(dim_));
+    for(const Instr& in : code_){
+        mix(&in.op, sizeof(in.op));
+        mix(&in.var, sizeof(in.var));
+        mix(&in.value, sizeof(in.value));
+    }
+    return h;
+}
+
+bool ObjectiveFunction::compile(const std::vector<Node>& nodes, int root, std::string* err)
+{
+    auto setErr=[&](const std::string& m){ if(err) *err=m; };
+
+    // Count the uses of every reachable node; folded-away nodes are never reached.
+    std::vector<int> uses(nodes.size(), 0);
+    {
+        std::vector<int> todo{root};
+        uses[static_cast<size_t>(root)] = 1;
+        while(!todo.empty()){
+            const Node& nd = nodes[static_cast<size_t>(todo.back())];
+            todo.pop_back();
+            for(int c : {nd.a, nd.b}){
+                if(c<0) continue;
+                if(uses[static_cast<size_t>(c)]++ == 0) todo.push_back(c);
+            }
+        }
+    }
+
+    // Iterative post-order walk. An operator node with several uses is computed once and
+    // parked in a register (Store); later uses push it back (Load). A register is freed
+    // after the last Load so that registers are reused across the program.
+    std::vector<Instr> code;
+    int depth=0, maxDepth=0, numRegs=0;
+    std::vector<int> reg(nodes.size(), -1), remaining(uses), freeRegs;
+    std::vector<std::pair<int, bool>> work{{root, false}};
+
+    auto emit=[&](Op op, int var, double value, int pops){
+        Instr in; in.op=op; in.var=var; in.value=value;
+        code.push_back(in);
+        depth += (op==Op::Store) ? 0 : 1 - pops;
+        if(depth>maxDepth) maxDepth=depth;
+    };
+
+    while(!work.empty()){
+        const auto [idx, expanded] = work.back();
+        work.pop_back();
+        const size_t i = static_cast<size_t>(idx);
+        const Node& nd = nodes[i];
+        const int pops = arity(nd.op);
+
+        if(!expanded && reg[i]>=0){
+            emit(Op::Load, reg[i], 0.0, 0);
+            if(--remaining[i]==0){ freeRegs.push_back(reg[i]); reg[i]=-1; }
+            continue;
+        }
+        if(!expanded && pops>0){
+            work.push_back({idx, true});
+            if(pops==2) work.push_back({nd.b, false});
+            work.push_back({nd.a, false});
+            continue;
+        }
+
+        emit(nd.op, nd.var, nd.value, pops);
+
+        if(--remaining[i]>0 && pops>0){
+            int r=-1;
+            if(!freeRegs.empty()){ r=freeRegs.back(); freeRegs.pop_back(); }
+            else if(numRegs<kMaxRegisters) r=numRegs++;
+            if(r>=0){
+                emit(Op::Store, r, 0.0, 0);
+                reg[i]=r;
+            }
+        }
+    }
+
+    if(maxDepth>kMaxStack){
+        std::ostringstream oss; oss<<"Expression is nested too deeply (stack depth "<<maxDepth<<" > "<<kMaxStack<<").";
+        setErr(oss.str());
+        return false;
+    }
+
+    code_ = std::move(code);
+    maxStack_ = maxDepth;
+    numRegs_ = numRegs;
+    return true;
+}
+
+double ObjectiveFunction::run(const double* x) const
+{
+    if(native_) return native_(x);
+    if(code_.empty()) return std::numeric_limits<double>::quiet_NaN();
+
+    // compile() has validated the stack effect of every instruction, so no bounds checks here.
+    double st[kMaxStack];
+    double regs[kMaxRegisters];
+    int sp=0;
+
+    for(const Instr& in : code_){
+        switch(in.op){
+            case Op::Const: st[sp++]=in.value; break;
+            case Op::Var:   st[sp++]=x[in.var]; break;
+            case Op::Store: regs[in.var]=st[sp-1]; break;
+            case Op::Load:  st[sp++]=regs[in.var]; break;
+            case Op::Add: --sp; st[sp-1] = st[sp-1] + st[sp]; break;
+            case Op::Sub: --sp; st[sp-1] = st[sp-1] - st[sp]; break;
+            case Op::Mul: --sp; st[sp-1] = st[sp-1] * st[sp]; break;
+            case Op::Div: --sp; st[sp-1] = st[sp-1] / st[sp]; break;
+            case Op::Pow: --sp; st[sp-1] = std::pow(st[sp-1], st[sp]); break;
+            case Op::Min: --sp; st[sp-1] = (st[sp-1]<st[sp]) ? st[sp-1] : st[sp]; break;
+            case Op::Max: --sp; st[sp-1] = (st[sp-1]>st[sp]) ? st[sp-1] : st[sp]; break;
+            case Op::Sin:   st[sp-1]=std::sin(st[sp-1]); break;
+            case Op::Cos:   st[sp-1]=std::cos(st[sp-1]); break;
+            case Op::Tan:   st[sp-1]=std::tan(st[sp-1]); break;
+            case Op::Asin:  st[sp-1]=std::asin(st[sp-1]); break;
+            case Op::Acos:  st[sp-1]=std::acos(st[sp-1]); break;
+            case Op::Atan:  st[sp-1]=std::atan(st[sp-1]); break;
+            case Op::Exp:   st[sp-1]=std::exp(st[sp-1]); break;
+            case Op::Log:   st[sp-1]=std::log(st[sp-1]); break;
+            case Op::Log10: st[sp-1]=std::log10(st[sp-1]); break;
+            case Op::Sqrt:  st[sp-1]=std::sqrt(st[sp-1]); break;
+            case Op::Abs:   st[sp-1]=std::fabs(st[sp-1]); break;
+            case Op::Floor: st[sp-1]=std::floor(st[sp-1]); break;
+            case Op::Ceil:  st[sp-1]=std::ceil(st[sp-1]); break;
+            case Op::Neg:   st[sp-1]=0.0-st[sp-1]; break;
+            case Op::Sqr:   st[sp-1]=st[sp-1]*st[sp-1]; break;
+            case Op::Cube:  st[sp-1]=(st[sp-1]*st[sp-1])*st[sp-1]; break;
+        }
+    }
+    return st[0];
+}
+
+// ---- Batched evaluation -----------------------------------------------------------
+//
+// Each kernel works on one block of the evaluation stack (n <= kBatchBlock lanes). The
+// arithmetic kernels use AVX2 or SSE2 when the build enables them and a scalar loop
+// otherwise; every path computes exactly what run() computes for a single point.
+
+namespace {
+
+#if defined(__AVX2__)
+constexpr int kLanes = 4;
+using VecD = __m256d;
+inline VecD vload(const double* p){ return _mm256_loadu_pd(p); }
+inline void vstore(double* p, VecD v){ _mm256_storeu_pd(p, v); }
+inline VecD vadd(VecD a, VecD b){ return _mm256_add_pd(a, b); }
+inline VecD vsub(VecD a, VecD b){ return _mm256_sub_pd(a, b); }
+inline VecD vmul(VecD a, VecD b){ return _mm256_mul_pd(a, b); }
+inline VecD vdiv(VecD a, VecD b){ return _mm256_div_pd(a, b); }
+inline VecD vmin(VecD a, VecD b){ return _mm256_min_pd(a, b); }  // a<b ? a : b
+inline VecD vmax(VecD a, VecD b){ return _mm256_max_pd(a, b); }  // a>b ? a : b
+inline VecD vsqrt(VecD a){ return _mm256_sqrt_pd(a); }
+inline VecD vabs(VecD a){ return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+inline VecD vzero(){ return _mm256_setzero_pd(); }
+inline VecD vfloor(VecD a){ return _mm256_floor_pd(a); }
+inline VecD vceil(VecD a){ return _mm256_ceil_pd(a); }
+#define FVT_SIMD_ROUNDING 1
+#elif defined(__SSE2__) || defined(_M_X64)
+constexpr int kLanes = 2;
+using VecD = __m128d;
+inline VecD vload(const double* p){ return _mm_loadu_pd(p); }
+inline void vstore(double* p, VecD v){ _mm_storeu_pd(p, v); }
+inline VecD vadd(VecD a, VecD b){ return _mm_add_pd(a, b); }
+inline VecD vsub(VecD a, VecD b){ return _mm_sub_pd(a, b); }
+inline VecD vmul(VecD a, VecD b){ return _mm_mul_pd(a, b); }
+inline VecD vdiv(VecD a, VecD b){ return _mm_div_pd(a, b); }
+inline VecD vmin(VecD a, VecD b){ return _mm_min_pd(a, b); }  // a<b ? a : b
+inline VecD vmax(VecD a, VecD b){ return _mm_max_pd(a, b); }  // a>b ? a : b
+inline VecD vsqrt(VecD a){ return _mm_sqrt_pd(a); }
+inline VecD vabs(VecD a){ return _mm_andnot_pd(_mm_set1_pd(-0.0), a); }
+inline VecD vzero(){ return _mm_setzero_pd(); }
+#else
+constexpr int kLanes = 0;
+#endif
+
+enum class Bin { Add, Sub, Mul, Div, Min, Max };
+enum class Un { Sqrt, Abs, Floor, Ceil, Neg, Sqr, Cube };
+
+template <Bin B>
+inline double binScalar(double a, double b)
+{
+    switch(B){
+        case Bin::Add: return a + b;
+        case Bin::Sub: return a - b;
+        case Bin::Mul: return a * b;
+        case Bin::Div: return a / b;
+        case Bin::Min: return (a<b) ? a : b;
+        case Bin::Max: return (a>b) ? a : b;
+    }
+    return 0.0;
+}
+
+template <Un U>
+inline double unScalar(double a)
+{
+    switch(U){
+        case Un::Sqrt:  return std::sqrt(a);
+        case Un::Abs:   return std::fabs(a);
+        case Un::Floor: return std::floor(a);
+        case Un::Ceil:  return std::ceil(a);
+        case Un::Neg:   return 0.0 - a;
+        case Un::Sqr:   return a * a;
+        case Un::Cube:  return (a * a) * a;
+    }
+    return 0.0;
+}
+
+// a[k] = a[k] (op) b[k]
+template <Bin B>
+void binBlock(double* a, const double* b, int n)
+{
+    int k=0;
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+    for(; k+kLanes<=n; k+=kLanes){
+        const VecD va = vload(a+k), vb = vload(b+k);
+        VecD r;
+        switch(B){
+            case Bin::Add: r = vadd(va, vb); break;
+            case Bin::Sub: r = vsub(va, vb); break;
+            case Bin::Mul: r = vmul(va, vb); break;
+            case Bin::Div: r = vdiv(va, vb); break;
+            case Bin::Min: r = vmin(va, vb); break;
+            case Bin::Max: r = vmax(va, vb); break;
+        }
+        vstore(a+k, r);
+    }
+#endif
+    for(; k<n; k++) a[k] = binScalar<B>(a[k], b[k]);
+}
+
+template <Un U>
+void unBlock(double* a, int n)
+{
+    int k=0;
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+    if(U==Un::Sqrt || U==Un::Abs || U==Un::Neg || U==Un::Sqr || U==Un::Cube
+#if defined(FVT_SIMD_ROUNDING)
+       || U==Un::Floor || U==Un::Ceil
+#endif
+      ){
+        for(; k+kLanes<=n; k+=kLanes){
+            const VecD va = vload(a+k);
+            VecD r = va;
+            switch(U){
+                case Un::Sqrt: r = vsqrt(va); break;
+                case Un::Abs:  r = vabs(va); break;
+                case Un::Neg:  r = vsub(vzero(), va); break;
+                case Un::Sqr:  r = vmul(va, va); break;
+                case Un::Cube: r = vmul(vmul(va, va), va); break;
+#if defined(FVT_SIMD_ROUNDING)
+                case Un::Floor: r = vfloor(va); break;
+                case Un::Ceil:  r = vceil(va); break;
+#else
+                default: break;
+#endif
+            }
+            vstore(a+k, r);
+        }
+    }
+#endif
+    for(; k<n; k++) a[k] = unScalar<U>(a[k]);
+}
+
+// Transcendentals have no portable SIMD form; keep them in tight scalar loops.
+template <double (*F)(double)>
+void mapBlock(double* a, int n)
+{
+    for(int k=0;k<n;k++) a[k] = F(a[k]);
+}
+
+double libSin(double a){ return std::sin(a); }
+double libCos(double a){ return std::cos(a); }
+double libTan(double a){ return std::tan(a); }
+double libAsin(double a){ return std::asin(a); }
+double libAcos(double a){ return std::acos(a); }
+double libAtan(double a){ return std::atan(a); }
+double libExp(double a){ return std::exp(a); }
+double libLog(double a){ return std::log(a); }
+double libLog10(double a){ return std::log10(a); }
+double libFloor(double a){ return std::floor(a); }
+double libCeil(double a){ return std::ceil(a); }
+double libPow(double a, double b){ return std::pow(a, b); }
+
+} // namespace
+
+void ObjectiveFunction::evaluateBatch(const Column* columns, std::size_t count, double* out) const
+{
+    if(code_.empty()){
+        for(std::size_t k=0;k<count;k++) out[k] = std::numeric_limits<double>::quiet_NaN();
+        return;
+    }
+
+    // Native code runs one point at a time. For short programs the interpreter's SIMD
+    // kernels are as fast or faster; past a few dozen instructions native code wins
+    // (typically 1.2-2x on the hartmann/shekel presets).
+    constexpr std::size_t kNativeBatchMinInstrs = 48;
+    if(native_ && code_.size() >= kNativeBatchMinInstrs){
+        thread_local std::vector<double> point;
+        point.resize(static_cast<size_t>(dim_));
+        for(std::size_t k=0;k<count;k++){
+            for(int d=0;d<dim_;d++) point[static_cast<size_t>(d)] = columns[d].data[static_cast<std::ptrdiff_t>(k)*columns[d].stride];
+            out[k] = native_(point.data());
+        }
+        return;
+    }
+
+    // Per-thread scratch so repeated calls (one per grid row) do not allocate: the stack
+    // levels followed by the registers, one block each.
+    thread_local std::vector<double> scratch;
+    const size_t need = static_cast<size_t>(maxStack_ + numRegs_) * kBatchBlock;
+    if(scratch.size() < need) scratch.resize(need);
+
+    for(std::size_t off=0; off<count; off+=kBatchBlock){
+        const int n = static_cast<int>(std::min<std::size_t>(kBatchBlock, count-off));
+        runBlock(columns, off, n, scratch.data(), out+off);
+    }
+}
+
+void ObjectiveFunction::runBlock(const Column* columns, std::size_t offset, int n, double* stack, double* out) const
+{
+    int sp=0;
+    auto top=[&](int back)->double*{ return stack + static_cast<size_t>(sp-back)*kBatchBlock; };
+    auto regAt=[&](int r)->double*{ return stack + static_cast<size_t>(maxStack_ + r)*kBatchBlock; };
+
+    for(const Instr& in : code_){
+        switch(in.op){
+            case Op::Const: {
+                double* d = top(0);
+                for(int k=0;k<n;k++) d[k]=in.value;
+                sp++;
+                break;
+            }
+            case Op::Var: {
+                const Column& c = columns[in.var];
+                double* d = top(0);
+                if(c.stride==0){
+                    const double v = c.data[0];
+                    for(int k=0;k<n;k++) d[k]=v;
+                } else {
+                    const double* src = c.data + static_cast<std::ptrdiff_t>(offset)*c.stride;
+                    for(int k=0;k<n;k++) d[k]=src[k*c.stride];
+                }
+                sp++;
+                break;
+            }
+            case Op::Store: std::copy(top(1), top(1)+n, regAt(in.var)); break;
+            case Op::Load: {
+                const double* r = regAt(in.var);
+                std::copy(r, r+n, top(0));
+                sp++;
+                break;
+            }
+            case Op::Add: binBlock<Bin::Add>(top(2), top(1), n); sp--; break;
+            case Op::Sub: binBlock<Bin::Sub>(top(2), top(1), n); sp--; break;
+            case Op::Mul: binBlock<Bin::Mul>(top(2), top(1), n); sp--; break;
+            case Op::Div: binBlock<Bin::Div>(top(2), top(1), n); sp--; break;
+            case Op::Min: binBlock<Bin::Min>(top(2), top(1), n); sp--; break;
+            case Op::Max: binBlock<Bin::Max>(top(2), top(1), n); sp--; break;
+            case Op::Pow: {
+                double* a = top(2);
+                const double* b = top(1);
+                for(int k=0;k<n;k++) a[k] = std::pow(a[k], b[k]);
+                sp--;
+                break;
+            }
+            case Op::Sin:   mapBlock<libSin>(top(1), n); break;
+            case Op::Cos:   mapBlock<libCos>(top(1), n); break;
+            case Op::Tan:   mapBlock<libTan>(top(1), n); break;
+            case Op::Asin:  mapBlock<libAsin>(top(1), n); break;
+            case Op::Acos:  mapBlock<libAcos>(top(1), n); break;
+            case Op::Atan:  mapBlock<libAtan>(top(1), n); break;
+            case Op::Exp:   mapBlock<libExp>(top(1), n); break;
+            case Op::Log:   mapBlock<libLog>(top(1), n); break;
+            case Op::Log10: mapBlock<libLog10>(top(1), n); break;
+            case Op::Sqrt:  unBlock<Un::Sqrt>(top(1), n); break;
+            case Op::Abs:   unBlock<Un::Abs>(top(1), n); break;
+            case Op::Floor: unBlock<Un::Floor>(top(1), n); break;
+            case Op::Ceil:  unBlock<Un::Ceil>(top(1), n); break;
+            case Op::Neg:   unBlock<Un::Neg>(top(1), n); break;
+            case Op::Sqr:   unBlock<Un::Sqr>(top(1), n); break;
+            case Op::Cube:  unBlock<Un::Cube>(top(1), n); break;
+        }
+    }
+
+    for(int k=0;k<n;k++) out[k] = stack[k];
+}
+
+void ObjectiveFunction::evaluateBatchDual(const Column* columns, const Column* seeds, int lanes, std::size_t count,
+                                          double* out, double* dout) const
+{
+    lanes = std::max(lanes, 0);
+    if(code_.empty()){
+        const double nan = std::numeric_limits<double>::quiet_NaN();
+        std::fill(out, out+count, nan);
+        std::fill(dout, dout + static_cast<size_t>(lanes)*count, nan);
+        return;
+    }
+
+    // Short batches (single points) get a matching block so the scratch stays small.
+    const int block = static_cast<int>(std::min<std::size_t>(kBatchBlock, std::max<std::size_t>(count, 1)));
+    thread_local std::vector<double> scratch;
+    const size_t slot = static_cast<size_t>(1 + lanes) * static_cast<size_t>(block);
+    const size_t need = static_cast<size_t>(maxStack_ + numRegs_) * slot + static_cast<size_t>(block);
+    if(scratch.size() < need) scratch.resize(need);
+
+    for(std::size_t off=0; off<count; off+=static_cast<size_t>(block)){
+        const int n = static_cast<int>(std::min<std::size_t>(static_cast<size_t>(block), count-off));
+        runBlockDual(columns, seeds, lanes, off, n, block, scratch.data(), out+off, dout+off, count);
+    }
+}
+
+double ObjectiveFunction::evaluateGradient(const double* x, double* grad) const
+{
+    // One lane per variable, seeded with the unit vectors.
+    thread_local std::vector<Column> cols, seeds;
+    const double one = 1.0;
+    const size_t d = static_cast<size_t>(dim_);
+    cols.resize(d);
+    seeds.assign(d*d, Column{nullptr, 0});
+    for(size_t v=0; v<d; v++){
+        cols[v] = {x + v, 0};
+        seeds[v*d + v] = {&one, 0};
+    }
+    double f = 0.0;
+    evaluateBatchDual(cols.data(), seeds.data(), dim_, 1, &f, grad);
+    return f;
+}
+
+void ObjectiveFunction::runBlockDual(const Column* columns, const Column* seeds, int lanes, std::size_t offset,
+                                     int n, int block, double* stack, double* out, double* dout,
+                                     std::size_t laneStride) const
+{
+    const size_t B = static_cast<size_t>(block);
+    const size_t slot = static_cast<size_t>(1 + lanes) * B;
+    const int rows = 1 + lanes;
+    int sp=0;
+    auto top=[&](int back)->double*{ return stack + static_cast<size_t>(sp-back)*slot; };
+    auto regAt=[&](int r)->double*{ return stack + static_cast<size_t>(maxStack_ + r)*slot; };
+    auto lane=[&](double* s, int l)->double*{ return s + static_cast<size_t>(1 + l)*B; };
+    double* g = stack + static_cast<size_t>(maxStack_ + numRegs_)*slot;   // f'(a) per point
+
+    // Unary builtins: fn(a, value, derivative); the lanes are scaled by the derivative. A
+    // zero lane stays zero even where the derivative is infinite (sqrt at 0 along a
+    // direction that does not move its argument).
+    auto unary=[&](auto fn){
+        double* s = top(1);
+        for(int k=0;k<n;k++){
+            double v, d;
+            fn(s[k], v, d);
+            s[k] = v;
+            g[k] = d;
+        }
+        for(int l=0;l<lanes;l++){
+            double* t = lane(s, l);
+            for(int k=0;k<n;k++) t[k] = (t[k]==0.0) ? 0.0 : t[k]*g[k];
+        }
+    };
+    // min/max: value and lanes of the operand that is selected.
+    auto select=[&](bool takeMin){
+        double* a = top(2);
+        const double* b = top(1);
+        for(int k=0;k<n;k++){
+            const bool keepA = takeMin ? (a[k]<b[k]) : (a[k]>b[k]);
+            if(keepA) continue;
+            for(int r=0;r<rows;r++) a[static_cast<size_t>(r)*B + static_cast<size_t>(k)] = b[static_cast<size_t>(r)*B + static_cast<size_t>(k)];
+        }
+        sp--;
+    };
+
+    for(const Instr& in : code_){
+        switch(in.op){
+            case Op::Const: {
+                double* d = top(0);
+                for(int k=0;k<n;k++) d[k]=in.value;
+                for(int l=0;l<lanes;l++) std::fill(lane(d, l), lane(d, l)+n, 0.0);
+                sp++;
+                break;
+            }
+            case Op::Var: {
+                double* d = top(0);
+                for(int r=0;r<rows;r++){
+                    const Column& c = (r==0) ? columns[in.var] : seeds[static_cast<size_t>(in.var)*static_cast<size_t>(lanes) + static_cast<size_t>(r-1)];
+                    double* dst = d + static_cast<size_t>(r)*B;
+                    if(!c.data){
+                        std::fill(dst, dst+n, 0.0);
+                    } else if(c.stride==0){
+                        std::fill(dst, dst+n, c.data[0]);
+                    } else {
+                        const double* src = c.data + static_cast<std::ptrdiff_t>(offset)*c.stride;
+                        for(int k=0;k<n;k++) dst[k]=src[k*c.stride];
+                    }
+                }
+                sp++;
+                break;
+            }
+            case Op::Store: std::copy(top(1), top(1)+slot, regAt(in.var)); break;
+            case Op::Load: {
+                const double* r = regAt(in.var);
+                std::copy(r, r+slot, top(0));
+                sp++;
+                break;
+            }
+            case Op::Add: {
+                double* a = top(2);
+                const double* b = top(1);
+                for(size_t k=0;k<slot;k++) a[k] += b[k];
+                sp--;
+                break;
+            }
+            case Op::Sub: {
+                double* a = top(2);
+                const double* b = top(1);
+                for(size_t k=0;k<slot;k++) a[k] -= b[k];
+                sp--;
+                break;
+            }
+            case Op::Mul: {
+                // (a, da)(b, db) = (ab, da b + a db)
+                double* a = top(2);
+                double* b = top(1);
+                for(int l=0;l<lanes;l++){
+                    double* ta = lane(a, l);
+                    const double* tb = lane(b, l);
+                    for(int k=0;k<n;k++) ta[k] = ta[k]*b[k] + a[k]*tb[k];
+                }
+                for(int k=0;k<n;k++) a[k] *= b[k];
+                sp--;
+                break;
+            }
+            case Op::Div: {
+                // (a/b, (da - (a/b) db) / b)
+                double* a = top(2);
+                double* b = top(1);
+                for(int k=0;k<n;k++) a[k] /= b[k];
+                for(int l=0;l<lanes;l++){
+                    double* ta = lane(a, l);
+                    const double* tb = lane(b, l);
+                    for(int k=0;k<n;k++) ta[k] = (ta[k] - a[k]*tb[k]) / b[k];
+                }
+                sp--;
+                break;
+            }
+            case Op::Pow: {
+                // d(a^b) = b a^(b-1) da + a^b ln(a) db; each term only where its lane moves, so
+                // constant exponents of negative bases stay finite.
+                double* a = top(2);
+                double* b = top(1);
+                for(int k=0;k<n;k++){
+                    const double av = a[k], bv = b[k];
+                    const double r = std::pow(av, bv);
+                    double dBase = std::numeric_limits<double>::quiet_NaN();
+                    double dExp = std::numeric_limits<double>::quiet_NaN();
+                    for(int l=0;l<lanes;l++){
+                        const double da = lane(a, l)[k], db = lane(b, l)[k];
+                        double d = 0.0;
+                        if(da!=0.0){
+                            if(std::isnan(dBase)) dBase = (bv==0.0) ? 0.0 : bv*std::pow(av, bv-1.0);
+                            d += dBase*da;
+                        }
+                        if(db!=0.0){
+                            if(std::isnan(dExp)) dExp = r*std::log(av);
+                            d += dExp*db;
+                        }
+                        lane(a, l)[k] = d;
+                    }
+                    a[k] = r;
+                }
+                sp--;
+                break;
+            }
+            case Op::Min: select(true); break;
+            case Op::Max: select(false); break;
+            case Op::Sin:   unary([](double a, double& v, double& d){ v=std::sin(a); d=std::cos(a); }); break;
+            case Op::Cos:   unary([](double a, double& v, double& d){ v=std::cos(a); d=-std::sin(a); }); break;
+            case Op::Tan:   unary([](double a, double& v, double& d){ v=std::tan(a); d=1.0+v*v; }); break;
+            case Op::Asin:  unary([](double a, double& v, double& d){ v=std::asin(a); d=1.0/std::sqrt(1.0-a*a); }); break;
+            case Op::Acos:  unary([](double a, double& v, double& d){ v=std::acos(a); d=-1.0/std::sqrt(1.0-a*a); }); break;
+            case Op::Atan:  unary([](double a, double& v, double& d){ v=std::atan(a); d=1.0/(1.0+a*a); }); break;
+            case Op::Exp:   unary([](double a, double& v, double& d){ v=std::exp(a); d=v; }); break;
+            case Op::Log:   unary([](double a, double& v, double& d){ v=std::log(a); d=1.0/a; }); break;
+            case Op::Log10: unary([](double a, double& v, double& d){ v=std::log10(a); d=1.0/(a*2.302585092994046); }); break;
+            case Op::Sqrt:  unary([](double a, double& v, double& d){ v=std::sqrt(a); d=0.5/v; }); break;
+            case Op::Abs:   unary([](double a, double& v, double& d){ v=std::fabs(a); d=(a>0.0) ? 1.0 : (a<0.0 ? -1.0 : 0.0); }); break;
+            case Op::Floor: unary([](double a, double& v, double& d){ v=std::floor(a); d=0.0; }); break;
+            case Op::Ceil:  unary([](double a, double& v, double& d){ v=std::ceil(a); d=0.0; }); break;
+            case Op::Neg:   unary([](double a, double& v, double& d){ v=0.0-a; d=-1.0; }); break;
+            case Op::Sqr:   unary([](double a, double& v, double& d){ v=a*a; d=2.0*a; }); break;
+            case Op::Cube:  unary([](double a, double& v, double& d){ v=(a*a)*a; d=3.0*(a*a); }); break;
+        }
+    }
+
+    for(int k=0;k<n;k++) out[k] = stack[k];
+    for(int l=0;l<lanes;l++){
+        const double* t = lane(stack, l);
+        for(int k=0;k<n;k++) dout[static_cast<size_t>(l)*laneStride + static_cast<size_t>(k)] = t[k];
+    }
+}
+
+namespace {
+
+using Iv = ObjectiveFunction::Interval;
+constexpr double kInf = std::numeric_limits<double>::infinity();
+constexpr double kPi = 3.14159265358979323846;
+
+Iv emptyIv() { return {kInf, -kInf}; }
+Iv entireIv() { return {-kInf, kInf}; }
+
+// Outward rounding: one step covers a correctly rounded operation; library functions get
+// two, assuming they are accurate to one ulp.
+Iv outward(double lo, double hi, int ulps = 1)
+{
+    for(int k=0;k<ulps;k++){
+        lo = std::nextafter(lo, -kInf);
+        hi = std::nextafter(hi, kInf);
+    }
+    return {lo, hi};
+}
+
+// Hull of up to four endpoint results; NaN ones (0*inf) count as 0.
+Iv hull4(double a, double b, double c, double d, int ulps)
+{
+    double v[4] = {a, b, c, d};
+    double lo = kInf, hi = -kInf;
+    for(double x : v){
+        if(std::isnan(x)) x = 0.0;
+        lo = std::min(lo, x);
+        hi = std::max(hi, x);
+    }
+    return outward(lo, hi, ulps);
+}
+
+Iv ivMul(Iv a, Iv b)
+{
+    return hull4(a.lo*b.lo, a.lo*b.hi, a.hi*b.lo, a.hi*b.hi, 1);
+}
+
+Iv ivDiv(Iv a, Iv b)
+{
+    if(b.contains(0.0)) return entireIv();
+    return hull4(a.lo/b.lo, a.lo/b.hi, a.hi/b.lo, a.hi/b.hi, 1);
+}
+
+// a^n for integer n.
+Iv ivPowInt(Iv a, double n)
+{
+    if(n==0.0) return {1.0, 1.0};
+    if(n<0.0) return ivDiv({1.0, 1.0}, ivPowInt(a, -n));
+    const double pl = std::pow(a.lo, n), ph = std::pow(a.hi, n);
+    if(std::fmod(n, 2.0)!=0.0) return outward(pl, ph, 2);    // odd: increasing
+    if(a.lo >= 0.0) return outward(pl, ph, 2);
+    if(a.hi <= 0.0) return outward(ph, pl, 2);
+    return outward(0.0, std::max(pl, ph), 2);
+}
+
+Iv ivPow(Iv a, Iv b)
+{
+    if(b.lo==b.hi && std::floor(b.lo)==b.lo && std::fabs(b.lo) < 9007199254740992.0) return ivPowInt(a, b.lo);
+    // Negative bases are only defined for integer exponents; do not try to track those.
+    if(a.lo < 0.0) return entireIv();
+    // For x >= 0, x^y = exp(y log x) with y log x bilinear in (y, log x): extremes at corners.
+    return hull4(std::pow(a.lo, b.lo), std::pow(a.lo, b.hi), std::pow(a.hi, b.lo), std::pow(a.hi, b.hi), 2);
+}
+
+// True if some t with t = phase (mod 2*pi) lies in a, widened a little so that rounding
+// cannot hide an extremum right at an end.
+bool hitsPhase(Iv a, double phase)
+{
+    const double margin = 1e-9 * (1.0 + std::max(std::fabs(a.lo), std::fabs(a.hi)));
+    const double k = std::ceil((a.lo - margin - phase) / (2.0*kPi));
+    return phase + 2.0*kPi*k <= a.hi + margin;
+}
+
+// sin or cos: the ends plus any maximum (phase maxAt) or minimum (maxAt + pi) inside.
+Iv ivPeriodic(Iv a, double (*fn)(double), double maxAt)
+{
+    if(!std::isfinite(a.lo) || !std::isfinite(a.hi) || a.hi - a.lo >= 2.0*kPi) return {-1.0, 1.0};
+    const double fl = fn(a.lo), fh = fn(a.hi);
+    Iv r = outward(std::min(fl, fh), std::max(fl, fh), 2);
+    if(hitsPhase(a, maxAt)) r.hi = 1.0;
+    if(hitsPhase(a, maxAt + kPi)) r.lo = -1.0;
+    return {std::max(r.lo, -1.0), std::min(r.hi, 1.0)};
+}
+
+Iv ivTan(Iv a)
+{
+    // Increasing between the poles at pi/2 + k*pi.
+    if(!std::isfinite(a.lo) || !std::isfinite(a.hi) || a.hi - a.lo >= kPi) return entireIv();
+    if(hitsPhase(a, 0.5*kPi) || hitsPhase(a, 1.5*kPi)) return entireIv();
+    return outward(std::tan(a.lo), std::tan(a.hi), 2);
+}
+
+// Increasing function on [domLo, domHi]; the argument is clipped to the domain first.
+Iv ivIncreasing(Iv a, double (*fn)(double), double domLo, double domHi, int ulps)
+{
+    a.lo = std::max(a.lo, domLo);
+    a.hi = std::min(a.hi, domHi);
+    if(a.empty()) return emptyIv();
+    return outward(fn(a.lo), fn(a.hi), ulps);
+}
+
+double ivSqrtFn(double a){ return std::sqrt(a); }
+double ivExpFn(double a){ return std::exp(a); }
+double ivLogFn(double a){ return std::log(a); }
+double ivLog10Fn(double a){ return std::log10(a); }
+double ivAsinFn(double a){ return std::asin(a); }
+double ivAtanFn(double a){ return std::atan(a); }
+double ivSinFn(double a){ return std::sin(a); }
+double ivCosFn(double a){ return std::cos(a); }
+
+} // namespace
+
+ObjectiveFunction::Interval ObjectiveFunction::evaluateInterval(const Interval* box) const
+{
+    if(code_.empty()) return emptyIv();
+
+    Iv st[kMaxStack];
+    Iv regs[kMaxRegisters];
+    int sp=0;
+
+    for(const Instr& in : code_){
+        switch(in.op){
+            case Op::Const: st[sp++] = {in.value, in.value}; continue;
+            case Op::Var:   st[sp++] = box[in.var]; continue;
+            case Op::Store: regs[in.var] = st[sp-1]; continue;
+            case Op::Load:  st[sp++] = regs[in.var]; continue;
+            default: break;
+        }
+
+        if(arity(in.op)==2){
+            const Iv b = st[--sp];
+            const Iv a = st[sp-1];
+            Iv r;
+            if(a.empty() || b.empty()){
+                r = emptyIv();
+            } else {
+                switch(in.op){
+                    case Op::Add: r = outward(a.lo + b.lo, a.hi + b.hi); break;
+                    case Op::Sub: r = outward(a.lo - b.hi, a.hi - b.lo); break;
+                    case Op::Mul: r = ivMul(a, b); break;
+                    case Op::Div: r = ivDiv(a, b); break;
+                    case Op::Pow: r = ivPow(a, b); break;
+                    case Op::Min: r = {std::min(a.lo, b.lo), std::min(a.hi, b.hi)}; break;
+                    case Op::Max: r = {std::max(a.lo, b.lo), std::max(a.hi, b.hi)}; break;
+                    default: r = entireIv(); break;
+                }
+            }
+            st[sp-1] = r;
+            continue;
+        }
+
+        const Iv a = st[sp-1];
+        Iv r;
+        if(a.empty()){
+            r = emptyIv();
+        } else {
+            switch(in.op){
+                case Op::Sin:   r = ivPeriodic(a, ivSinFn, 0.5*kPi); break;
+                case Op::Cos:   r = ivPeriodic(a, ivCosFn, 0.0); break;
+                case Op::Tan:   r = ivTan(a); break;
+                case Op::Asin:  r = ivIncreasing(a, ivAsinFn, -1.0, 1.0, 2); break;
+                case Op::Acos: {
+                    const Iv c{std::max(a.lo, -1.0), std::min(a.hi, 1.0)};
+                    r = c.empty() ? emptyIv() : outward(std::acos(c.hi), std::acos(c.lo), 2);
+                    break;
+                }
+                case Op::Atan:  r = ivIncreasing(a, ivAtanFn, -kInf, kInf, 2); break;
+                case Op::Exp:   r = ivIncreasing(a, ivExpFn, -kInf, kInf, 2); r.lo = std::max(r.lo, 0.0); break;
+                case Op::Log:   r = ivIncreasing(a, ivLogFn, 0.0, kInf, 2); break;
+                case Op::Log10: r = ivIncreasing(a, ivLog10Fn, 0.0, kInf, 2); break;
+                case Op::Sqrt:  r = ivIncreasing(a, ivSqrtFn, 0.0, kInf, 1); r.lo = std::max(r.lo, 0.0); break;
+                case Op::Abs:
+                    r = (a.lo >= 0.0) ? a : (a.hi <= 0.0) ? Iv{-a.hi, -a.lo} : Iv{0.0, std::max(-a.lo, a.hi)};
+                    break;
+                case Op::Floor: r = {std::floor(a.lo), std::floor(a.hi)}; break;
+                case Op::Ceil:  r = {std::ceil(a.lo), std::ceil(a.hi)}; break;
+                case Op::Neg:   r = {-a.hi, -a.lo}; break;
+                case Op::Sqr:   r = ivPowInt(a, 2.0); break;
+                case Op::Cube:  r = ivPowInt(a, 3.0); break;
+                default: r = entireIv(); break;
+            }
+        }
+        st[sp-1] = r;
+    }
+    return st[0];
+}
+
+void ObjectiveFunction::compileNative()
+{
+    jit_.reset();
+    nativeFn_ = native_ = nullptr;
+    if(code_.empty() || !JitAssembler::supported()) return;
+
+    using A = JitAssembler::Arith;
+    JitAssembler as(maxStack_, numRegs_);
+    for(const Instr& in : code_){
+        switch(in.op){
+            case Op::Const: as.pushConst(in.value); break;
+            case Op::Var:   as.pushVar(in.var); break;
+            case Op::Store: as.store(in.var); break;
+            case Op::Load:  as.load(in.var); break;
+            case Op::Add:   as.arith(A::Add); break;
+            case Op::Sub:   as.arith(A::Sub); break;
+            case Op::Mul:   as.arith(A::Mul); break;
+            case Op::Div:   as.arith(A::Div); break;
+            case Op::Min:   as.arith(A::Min); break;
+            case Op::Max:   as.arith(A::Max); break;
+            case Op::Pow:   as.call2(libPow); break;
+            case Op::Sin:   as.call1(libSin); break;
+            case Op::Cos:   as.call1(libCos); break;
+            case Op::Tan:   as.call1(libTan); break;
+            case Op::Asin:  as.call1(libAsin); break;
+            case Op::Acos:  as.call1(libAcos); break;
+            case Op::Atan:  as.call1(libAtan); break;
+            case Op::Exp:   as.call1(libExp); break;
+            case Op::Log:   as.call1(libLog); break;
+            case Op::Log10: as.call1(libLog10); break;
+            case Op::Floor: as.call1(libFloor); break;
+            case Op::Ceil:  as.call1(libCeil); break;
+            case Op::Sqrt:  as.sqrt(); break;
+            case Op::Abs:   as.abs(); break;
+            case Op::Neg:   as.neg(); break;
+            case Op::Sqr:   as.sqr(); break;
+            case Op::Cube:  as.cube(); break;
+        }
+    }
+
+    jit_ = as.finish();
+    if(jit_) nativeFn_ = native_ = jit_->fn();
+}
@@ -1,8 +1,17 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
 #include <string>
+#include <tuple>
 #include <vector>
 #include <functional>
 
+struct SlicePlan;
+struct IncrementalPlan;
+class JitCode;
+
 class ObjectiveFunction
 {
 public:
@@ -15,12 +24,110 @@ public:
     bool setExpression(const std::string& expr, int dimension, std::string* errorMsg);
 
     double evaluate(const std::vector<double>& x) const;
+    // Unchecked variant for hot loops: x must point to dimension() values.
+    double evaluate(const double* x) const { return run(x); }
+
+    // Structure-of-arrays input for evaluateBatch(): one column per variable.
+    // Point k reads data[k*stride]; a stride of 0 broadcasts data[0] (fixed variables).
+    struct Column
+    {
+        const double* data{nullptr};
+        std::ptrdiff_t stride{1};
+    };
+
+    // Evaluates count points; columns must hold dimension() entries. Each opcode is run
+    // across a block of up to kBatchBlock points, so dispatch cost is paid once per block.
+    void evaluateBatch(const Column* columns, std::size_t count, double* out) const;
+
+    // Forward-mode differentiation: evaluates like evaluateBatch() while every instruction
+    // also carries `lanes` directional derivatives (dual numbers), so f and its slopes come
+    // out of one pass and each builtin is evaluated once per point. seeds[v*lanes + l] is the
+    // derivative of variable v along direction l, given per point like the columns; a null
+    // data pointer means 0. dout[l*count + k] receives the derivative of f along direction l
+    // at point k. Always interpreted. abs, min and max take the derivative of the active
+    // branch; floor and ceil have derivative 0.
+    void evaluateBatchDual(const Column* columns, const Column* seeds, int lanes, std::size_t count,
+                           double* out, double* dout) const;
+    // f(x) and its dimension() partial derivatives in grad, in one pass.
+    double evaluateGradient(const double* x, double* grad) const;
+
+    // Closed interval [lo, hi]; lo > hi (or NaN) is the empty interval.
+    struct Interval
+    {
+        double lo{0.0}, hi{0.0};
+
+        bool empty() const { return !(lo <= hi); }
+        bool contains(double v) const { return lo <= v && v <= hi; }
+    };
+
+    // Interval arithmetic: bounds for f over the box, which holds dimension() intervals
+    // (equal ends for fixed variables). Every f(x) with x in the box at which all operations
+    // are defined lies in the result: results are rounded outwards, parts of an argument
+    // outside a builtin's domain (sqrt, log, asin, ...) are dropped, and the result is empty
+    // if nothing is left. min and max are bounded as if both operands were defined. The
+    // bounds can be loose where a variable occurs several times; they tighten as the box
+    // shrinks.
+    Interval evaluateInterval(const Interval* box) const;
+
+    // Original token-walking evaluator; kept as a reference for benchmarks and cross-checks.
+    double evaluateReference(const std::vector<double>& x) const;
+
     int dimension() const { return dim_; }
     const std::string& expression() const { return expr_; }
+    int programSize() const { return static_cast<int>(code_.size()); }
+    int maxStackDepth() const { return maxStack_; }
+    // Instruction count before constant folding and algebraic simplification (= RPN length).
+    int unoptimizedSize() const { return static_cast<int>(rpn_.size()); }
+    // Common-subexpression statistics: operator nodes that were merged into an identical
+    // earlier node, and registers used to hold shared values between their uses.
+    int sharedSubexpressions() const { return shared_; }
+    int registerCount() const { return numRegs_; }
+    // Hash of the optimised program (dimension and bytecode). Expressions that compile to the
+    // same code, e.g. ones differing only in spacing or in constants that fold alike, share it.
+    std::uint64_t fingerprint() const;
+
+    // Native code (see Jit.h) is generated by setExpression() where supported; evaluate()
+    // and evaluateBatch() then use it instead of the interpreter. Disabling it keeps the code.
+    bool hasNativeCode() const { return jit_ != nullptr; }
+    void setNativeCodeEnabled(bool on) { native_ = on ? nativeFn_ : nullptr; }
+    bool nativeCodeEnabled() const { return native_ != nullptr; }
+
+    // Specialises the expression for a 2D slice (see SlicePlan): xVar and yVar stay free,
+    // every other variable k is replaced by fixed[k] and the expression re-optimised.
+    SlicePlan specializeSlice(int xVar, int yVar, const std::vector<double>& fixed) const;
+    // Like specializeSlice(), but fixed variable `var` stays free as well (see IncrementalPlan).
+    IncrementalPlan specializeIncremental(int xVar, int yVar, int var, const std::vector<double>& fixed) const;
+    // Copy with variable `var` replaced by `value` and re-optimised; the dimension and the
+    // numbering of the other variables are unchanged.
+    ObjectiveFunction bindVariable(int var, double value) const;
+
+    // Evaluation uses a fixed-size stack; deeper expressions are rejected by setExpression().
+    static constexpr int kMaxStack = 256;
+    // Shared values beyond this many live registers are recomputed instead of stored.
+    static constexpr int kMaxRegisters = 64;
+    static constexpr int kBatchBlock = 128;
 
 private:
     enum class TokType { Number, Var, Op, Func, LParen, RParen, Comma };
 
+    enum class Op : std::uint8_t {
+        Const, Var,
+        Add, Sub, Mul, Div, Pow,
+        Sin, Cos, Tan, Asin, Acos, Atan, Exp, Log, Log10, Sqrt, Abs, Floor, Ceil,
+        Min, Max,
+        Neg, Sqr, Cube,     // introduced by the simplifier: -a, a*a, (a*a)*a
+        Store, Load         // copy top of stack to register `var` / push register `var`
+    };
+
+    // One bytecode instruction; constants are stored inline. `var` is the variable index
+    // for Var and the register index for Store/Load.
+    struct Instr
+    {
+        Op op{Op::Const};
+        std::int32_t var{-1};
+        double value{0.0};
+    };
+
     struct Token
     {
         TokType type{};
@@ -33,6 +140,7 @@ private:
         // For functions:
         std::string funcName;
         int funcArity{1};
+        Op fnOp{Op::Const};
         std::function<double(double)> fn1;
         std::function<double(double,double)> fn2;
     };
@@ -41,10 +149,92 @@ private:
     static bool shuntingYardToRPN(const std::vector<Token>& in, std::vector<Token>& rpn, std::string* err);
     static bool bindFunctions(std::vector<Token>& rpn, std::string* err);
 
+    // Expression DAG built from the RPN; operands always precede the node using them.
+    struct Node
+    {
+        Op op{Op::Const};
+        int a{-1}, b{-1};
+        int var{-1};
+        double value{0.0};
+    };
+
+    // Hash-consed node table: structurally identical nodes share one index.
+    struct Dag
+    {
+        std::vector<Node> nodes;
+        std::map<std::tuple<Op, int, int, int, std::uint64_t>, int> index;
+        int shared{0};
+    };
+
+    static int arity(Op op);
+    static double applyOp(Op op, double a, double b);
+
+    // Optimisation pass: rebuilds the RPN as a DAG, folding variable-free subtrees,
+    // applying the rewrites in makeNode() and merging common subexpressions.
+    static bool buildDag(const std::vector<Token>& rpn, Dag& dag, int& root, std::string* err);
+    static int makeNode(Dag& dag, Op op, int a, int b);
+    static int intern(Dag& dag, const Node& n);
+
+    // Copies the nodes of `src` reachable from `root` into `out` through makeNode(), so
+    // that substituted leaves fold again. replace(i) may return a node of `out` to use
+    // instead of src[i] and everything below it, or -1 to copy src[i]. Returns the new root.
+    static int rebuild(const std::vector<Node>& src, int root, Dag& out, const std::function<int(int)>& replace);
+    static ObjectiveFunction fromDag(Dag&& dag, int root, int dim, const std::string& expr);
+
+    bool compile(const std::vector<Node>& nodes, int root, std::string* err);
+    void compileNative();
+
     double evalRPN(const std::vector<double>& x) const;
+    double run(const double* x) const;
+    void runBlock(const Column* columns, std::size_t offset, int n, double* stack, double* out) const;
+    // Stack slots hold a value row followed by one row per lane, `block` doubles each.
+    void runBlockDual(const Column* columns, const Column* seeds, int lanes, std::size_t offset, int n, int block,
+                      double* stack, double* out, double* dout, std::size_t laneStride) const;
 
 private:
     int dim_{0};
     std::string expr_;
     std::vector<Token> rpn_;
+
+    std::vector<Instr> code_;
+    int maxStack_{0};
+    int numRegs_{0};
+    int shared_{0};
+
+    std::shared_ptr<const JitCode> jit_;
+    double (*nativeFn_)(const double*){nullptr};
+    double (*native_)(const double*){nullptr};    // nativeFn_ unless disabled
+
+    // Optimised DAG the bytecode was generated from; kept for specialisation.
+    std::vector<Node> dag_;
+    int root_{-1};
+};
+
+// A slice-specialised expression split by what each part depends on:
+//
+//   f(x, y) = main(x, y, t_0, t_1, ...),   t_k = terms[k](x) or terms[k](y)
+//
+// Subtrees that depend on fixed variables only are folded into constants. The largest
+// subtrees that depend on x alone (or on y alone) become terms, so a grid sampler computes
+// them once per column (or row) rather than once per point.
+struct SlicePlan
+{
+    ObjectiveFunction main;                // variables: x0 = x, x1 = y, x(2+k) = t_k
+    std::vector<ObjectiveFunction> terms;  // one variable: x0 = x or y, see termAxis
+    std::vector<int> termAxis;             // 0: t_k is a function of x, 1: of y
+};
+
+// A slice-specialised expression with one fixed variable v left free, split by what depends
+// on it:
+//
+//   f(x, y) = top(v, p_0(x, y), p_1(x, y), ...)
+//
+// The parts p_k are the largest subtrees that do not depend on v (and are not constant), so
+// per-point values of the parts can be kept while v changes; only `top` has to be run again.
+// A sum at the top is first regrouped so that all of its v-independent addends form one
+// part: top = p_0 + g(v, ...).
+struct IncrementalPlan
+{
+    ObjectiveFunction top;                 // variables: x0 = v, x(1+k) = p_k
+    std::vector<ObjectiveFunction> parts;  // variables: x0 = x, x1 = y
 };
@@ -1,13 +1,32 @@
 #include "PlotWidget.h"
 
 #include <QPainter>
-#include <QPainterPath>
+#include <QResizeEvent>
 #include <QMouseEvent>
 #include <QToolTip>
 #include <QtMath>
+#include <algorithm>
+#include <array>
 #include <cmath>
 
-static bool finite(double v) { return std::isfinite(v); }
+#include "ThreadPool.h"
+
+static bool isFiniteValue(double v) { return std::isfinite(v); }
+
+// Heatmap colours: hue 240 (blue) at the minimum to 0 (red) at the maximum, as in the legend.
+static constexpr int kLutSize = 1024;
+
+static const std::array<QRgb, kLutSize>& heatmapLut()
+{
+    static const std::array<QRgb, kLutSize> lut = []
+    {
+        std::array<QRgb, kLutSize> t{};
+        for (int i = 0; i < kLutSize; ++i)
+            t[static_cast<size_t>(i)] = QColor::fromHsvF(240.0/360.0 * (1.0 - double(i)/(kLutSize - 1)), 1.0, 1.0).rgb();
+        return t;
+    }();
+    return lut;
+}
 
 PlotWidget::PlotWidget(QWidget* parent)
     : QWidget(parent)
@@ -22,23 +41,30 @@ void PlotWidget::clear()
     xs_.clear();
     ys_.clear();
     heatmap_ = QImage();
-    grid_.clear();
+    grid_.reset();
     gridW_ = gridH_ = 0;
+    lineLod_.clear();
     xLabel_.clear();
     yLabel_.clear();
     title_.clear();
+    invalidate();
+}
+
+void PlotWidget::invalidate()
+{
+    cacheValid_ = false;
     update();
 }
 
-void PlotWidget::setLineData(const QVector<double>& xs,
-                             const QVector<double>& ys,
+void PlotWidget::setLineData(QVector<double> xs,
+                             QVector<double> ys,
                              const QString& xLabel,
                              const QString& yLabel,
                              const QString& title)
 {
     mode_ = Mode::Line;
-    xs_ = xs;
-    ys_ = ys;
+    xs_ = std::move(xs);
+    ys_ = std::move(ys);
     xLabel_ = xLabel;
     yLabel_ = yLabel;
     title_ = title;
@@ -56,7 +82,7 @@ void PlotWidget::setLineData(const QVector<double>& xs,
     bool hasY = false;
     for (double v : ys_)
     {
-        if (finite(v))
+        if (isFiniteValue(v))
         {
             if (!hasY) { lineYMin_ = lineYMax_ = v; hasY = true; }
             else { if (v < lineYMin_) lineYMin_ = v; if (v > lineYMax_) lineYMax_ = v; }
@@ -64,36 +90,142 @@ void PlotWidget::setLineData(const QVector<double>& xs,
     }
     if (!hasY) { lineYMin_ = -1.0; lineYMax_ = 1.0; }
     if (lineYMin_ == lineYMax_) { lineYMin_ -= 1.0; lineYMax_ += 1.0; }
+    lineSorted_ = std::is_sorted(xs_.constData(), xs_.constData() + xs_.size());
 
-    update();
+    invalidate();
 }
 
-void PlotWidget::setHeatmapData(const QImage& img,
-                                const QVector<double>& gridValues,
-                                int gridW,
-                                int gridH,
+void PlotWidget::setHeatmapData(std::shared_ptr<const HeightGrid> grid,
                                 double xMin, double xMax,
                                 double yMin, double yMax,
-                                double fMin, double fMax,
                                 const QString& xLabel,
                                 const QString& yLabel,
                                 const QString& title)
 {
     mode_ = Mode::Heatmap;
-    heatmap_ = img;
-    grid_ = gridValues;
-    gridW_ = gridW;
-    gridH_ = gridH;
+    const bool changed = grid != grid_;
+    grid_ = std::move(grid);
+    gridW_ = gridH_ = grid_ ? grid_->n : 0;
 
     hmXMin_ = xMin; hmXMax_ = xMax;
     hmYMin_ = yMin; hmYMax_ = yMax;
-    hmFMin_ = fMin; hmFMax_ = fMax;
+    if (grid_) { hmFMin_ = grid_->zMin; hmFMax_ = grid_->zMax; }
 
     xLabel_ = xLabel;
     yLabel_ = yLabel;
     title_ = title;
 
-    update();
+    if (changed || heatmap_.isNull()) buildHeatmapImage();
+    invalidate();
+}
+
+void PlotWidget::buildHeatmapImage()
+{
+    const int n = gridW_;
+    if (!grid_ || n < 2 || grid_->z.size() != size_t(n) * size_t(n))
+    {
+        heatmap_ = QImage();
+        return;
+    }
+
+    // One pixel per sample, the top scanline being the last grid row. The image is kept
+    // while the size stays the same.
+    if (heatmap_.width() != n || heatmap_.height() != n || heatmap_.format() != QImage::Format_RGB32)
+        heatmap_ = QImage(n, n, QImage::Format_RGB32);
+    uchar* bits = heatmap_.bits();   // detaches here, not in the workers
+    const qsizetype stride = heatmap_.bytesPerLine();
+
+    const std::array<QRgb, kLutSize>& lut = heatmapLut();
+    const QRgb undefined = qRgb(128, 128, 128);
+    const double lo = hmFMin_;
+    const double scale = (hmFMax_ > hmFMin_) ? (kLutSize - 1) / (hmFMax_ - hmFMin_) : 0.0;
+    const double* z = grid_->z.data();
+
+    ThreadPool& pool = ThreadPool::global();
+    pool.parallelFor(n, std::max(1, n / (4 * pool.concurrency())), [&](int r0, int r1)
+    {
+        for (int r = r0; r < r1; ++r)
+        {
+            QRgb* line = reinterpret_cast<QRgb*>(bits + qsizetype(r) * stride);
+            const double* row = z + size_t(n - 1 - r) * size_t(n);
+            for (int i = 0; i < n; ++i)
+            {
+                const double t = (row[i] - lo) * scale;
+                line[i] = isFiniteValue(t) ? lut[static_cast<size_t>(std::clamp(t, 0.0, double(kLutSize - 1)))] : undefined;
+            }
+        }
+    });
+}
+
+void PlotWidget::decimateLine(const QRectF& pr, int columns)
+{
+    lineLod_.clear();
+    const int n = xs_.size();
+    if (n < 2 || ys_.size() != n) return;
+
+    const double* xs = xs_.constData();
+    const double* ys = ys_.constData();
+    const double xSpan = lineXMax_ - lineXMin_;
+    const double ySpan = lineYMax_ - lineYMin_;
+    auto point = [&](int k)
+    {
+        const double tx = (xSpan == 0.0) ? 0.0 : (xs[k] - lineXMin_) / xSpan;
+        return QPointF(pr.left() + tx * pr.width(), pr.bottom() - (ys[k] - lineYMin_) / ySpan * pr.height());
+    };
+
+    // Unordered x: no columns to bin into, every point is drawn.
+    if (!lineSorted_ || xSpan == 0.0)
+    {
+        lineLod_.reserve(n);
+        for (int k = 0; k < n; ++k)
+            if (isFiniteValue(xs[k]) && isFiniteValue(ys[k])) lineLod_.push_back(point(k));
+        return;
+    }
+
+    // M4: per pixel column the first, lowest, highest and last point, in series order. The
+    // polyline through them covers the same pixels as the one through every point.
+    columns = std::max(1, columns);
+    std::vector<std::array<int, 4>> picks(static_cast<size_t>(columns));
+    std::vector<int> counts(static_cast<size_t>(columns), 0);
+    auto edge = [&](int c)
+    {
+        return static_cast<int>(std::lower_bound(xs, xs + n, lineXMin_ + xSpan * double(c) / columns) - xs);
+    };
+
+    ThreadPool& pool = ThreadPool::global();
+    pool.parallelFor(columns, std::max(1, columns / (4 * pool.concurrency())), [&](int c0, int c1)
+    {
+        int begin = edge(c0);
+        for (int c = c0; c < c1; ++c)
+        {
+            const int end = (c == columns - 1) ? n : edge(c + 1);
+            int first = -1, last = -1, lo = -1, hi = -1;
+            for (int k = begin; k < end; ++k)
+            {
+                if (!isFiniteValue(ys[k])) continue;
+                if (first < 0) first = lo = hi = k;
+                last = k;
+                if (ys[k] < ys[lo]) lo = k;
+                if (ys[k] > ys[hi]) hi = k;
+            }
+            begin = end;
+            if (first < 0) continue;
+
+            std::array<int, 4>& pick = picks[static_cast<size_t>(c)];
+            int m = 0;
+            pick[m++] = first;
+            for (int k : { std::min(lo, hi), std::max(lo, hi), last })
+                if (k != pick[m - 1]) pick[m++] = k;
+            counts[static_cast<size_t>(c)] = m;
+        }
+    });
+
+    int total = 0;
+    for (int m : counts) total += m;
+    lineLod_.reserve(total);
+    for (int c = 0; c < columns; ++c)
+        for (int m = 0; m < counts[static_cast<size_t>(c)]; ++m)
+            lineLod_.push_back(point(picks[static_cast<size_t>(c)][static_cast<size_t>(m)]));
 }
 
 void PlotWidget::drawAxes(QPainter& p, const QRectF& pr, const QString& xLabel, const QString& yLabel)
@@ -157,7 +289,31 @@ void PlotWidget::drawTicks(QPainter& p, const QRectF& pr, double xMin, double xM
 
 void PlotWidget::paintEvent(QPaintEvent*)
 {
+    // The plot is drawn once per data change or resize; repaints (hover, exposure) only
+    // copy the cached pixmap.
+    const qreal dpr = devicePixelRatioF();
+    const QSize pixels(int(std::ceil(width() * dpr)), int(std::ceil(height() * dpr)));
+    if (!cacheValid_ || cache_.size() != pixels || cache_.devicePixelRatio() != dpr)
+    {
+        cache_ = QPixmap(pixels);
+        cache_.setDevicePixelRatio(dpr);
+        QPainter cp(&cache_);
+        renderPlot(cp);
+        cacheValid_ = true;
+    }
+
     QPainter p(this);
+    p.drawPixmap(0, 0, cache_);
+}
+
+void PlotWidget::resizeEvent(QResizeEvent* ev)
+{
+    cacheValid_ = false;
+    QWidget::resizeEvent(ev);
+}
+
+void PlotWidget::renderPlot(QPainter& p)
+{
     p.setRenderHint(QPainter::Antialiasing, true);
     p.fillRect(rect(), Qt::white);
 
@@ -182,37 +338,14 @@ void PlotWidget::paintEvent(QPaintEvent*)
     {
         drawTicks(p, pr, lineXMin_, lineXMax_, lineYMin_, lineYMax_);
 
-        // Draw line
-        if (xs_.size() >= 2 && ys_.size() == xs_.size())
+        // Draw line: at most four points per device pixel column
+        decimateLine(pr, int(std::ceil(pr.width() * devicePixelRatioF())));
+        if (lineLod_.size() >= 2)
         {
-            QPainterPath path;
-            bool started = false;
-
-            for (int i = 0; i < xs_.size(); ++i)
-            {
-                const double xv = xs_[i];
-                const double yv = ys_[i];
-                if (!finite(yv)) continue;
-
-                const double tx = (lineXMax_ == lineXMin_) ? 0.0 : ((xv - lineXMin_) / (lineXMax_ - lineXMin_));
-                const double ty = (lineYMax_ == lineYMin_) ? 0.0 : ((yv - lineYMin_) / (lineYMax_ - lineYMin_));
-                const double px = pr.left() + tx * pr.width();
-                const double py = pr.bottom() - ty * pr.height();
-
-                if (!started)
-                {
-                    path.moveTo(px, py);
-                    started = true;
-                }
-                else
-                {
-                    path.lineTo(px, py);
-                }
-            }
-
             p.save();
+            p.setClipRect(pr);
             p.setPen(QPen(Qt::darkBlue, 2));
-            p.drawPath(path);
+            p.drawPolyline(lineLod_.constData(), int(lineLod_.size()));
             p.restore();
         }
 
@@ -232,8 +365,10 @@ void PlotWidget::paintEvent(QPaintEvent*)
         // Color legend
         const QRectF legendRect(width() - 60, pr.top(), 18, pr.height());
         QLinearGradient grad(legendRect.topLeft(), legendRect.bottomLeft());
-        grad.setColorAt(0.0, QColor::fromHsv(0, 255, 255));
-        grad.setColorAt(1.0, QColor::fromHsv(240, 255, 255));
+        // Stops from the image LUT; two stops alone would blend red into blue through purple.
+        const std::array<QRgb, kLutSize>& lut = heatmapLut();
+        for (int k = 0; k <= 8; ++k)
+            grad.setColorAt(k / 8.0, QColor(lut[size_t((8 - k) * (kLutSize - 1) / 8)]));
         p.fillRect(legendRect, grad);
         p.setPen(Qt::black);
         p.drawRect(legendRect);
@@ -251,7 +386,7 @@ void PlotWidget::paintEvent(QPaintEvent*)
 
 void PlotWidget::mouseMoveEvent(QMouseEvent* ev)
 {
-    if (mode_ != Mode::Heatmap || heatmap_.isNull() || gridW_ <= 1 || gridH_ <= 1)
+    if (mode_ != Mode::Heatmap || heatmap_.isNull() || !grid_ || gridW_ <= 1 || gridH_ <= 1)
     {
         QWidget::mouseMoveEvent(ev);
         return;
@@ -280,7 +415,7 @@ void PlotWidget::mouseMoveEvent(QMouseEvent* ev)
 
     const double x = hmXMin_ + (double(ix) / double(gridW_ - 1)) * (hmXMax_ - hmXMin_);
     const double y = hmYMin_ + (double(iy) / double(gridH_ - 1)) * (hmYMax_ - hmYMin_);
-    const double f = grid_[iy * gridW_ + ix];
+    const double f = grid_->z[size_t(iy) * size_t(gridW_) + size_t(ix)];
 
     const QString text = QString("%1=%2\n%3=%4\nf=%5")
         .arg(xLabel_).arg(x, 0, 'g', 8)
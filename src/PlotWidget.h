@@ -2,7 +2,12 @@
 
 #include <QWidget>
 #include <QImage>
+#include <QPixmap>
+#include <QPointF>
 #include <QVector>
+#include <memory>
+
+#include "GridSampler.h"
 
 class PlotWidget : public QWidget
 {
@@ -12,19 +17,20 @@ public:
 
     void clear();
 
-    void setLineData(const QVector<double>& xs,
-                     const QVector<double>& ys,
+    // Takes the series by value: move large series in. Series with ascending x are drawn
+    // decimated to at most four points per pixel column (first, min, max, last).
+    void setLineData(QVector<double> xs,
+                     QVector<double> ys,
                      const QString& xLabel,
                      const QString& yLabel,
                      const QString& title);
 
-    void setHeatmapData(const QImage& img,
-                        const QVector<double>& gridValues,
-                        int gridW,
-                        int gridH,
+    // Shows grid (row j at y = yMin + j·(yMax-yMin)/(n-1)) coloured over [grid->zMin, grid->zMax].
+    // The grid is shared, not copied, and must not change while it is shown; the image is
+    // built from it directly and only when the grid itself changes.
+    void setHeatmapData(std::shared_ptr<const HeightGrid> grid,
                         double xMin, double xMax,
                         double yMin, double yMax,
-                        double fMin, double fMax,
                         const QString& xLabel,
                         const QString& yLabel,
                         const QString& title);
@@ -33,12 +39,18 @@ protected:
     void paintEvent(QPaintEvent* ev) override;
     void mouseMoveEvent(QMouseEvent* ev) override;
     void leaveEvent(QEvent* ev) override;
+    void resizeEvent(QResizeEvent* ev) override;
 
 private:
     enum class Mode { None, Line, Heatmap };
 
     void drawAxes(QPainter& p, const QRectF& pr, const QString& xLabel, const QString& yLabel);
     void drawTicks(QPainter& p, const QRectF& pr, double xMin, double xMax, double yMin, double yMax);
+    void buildHeatmapImage();
+    void decimateLine(const QRectF& pr, int columns);
+    void renderPlot(QPainter& p);
+    // Redraws the cached plot on the next paint.
+    void invalidate();
 
 private:
     Mode mode_ = Mode::None;
@@ -48,10 +60,12 @@ private:
     QVector<double> ys_;
     double lineXMin_ = 0.0, lineXMax_ = 1.0;
     double lineYMin_ = 0.0, lineYMax_ = 1.0;
+    bool lineSorted_ = false;
+    QVector<QPointF> lineLod_;   // decimated polyline in widget coordinates
 
     // Heatmap
     QImage heatmap_;
-    QVector<double> grid_;
+    std::shared_ptr<const HeightGrid> grid_;
     int gridW_ = 0, gridH_ = 0;
     double hmXMin_ = 0.0, hmXMax_ = 1.0;
     double hmYMin_ = 0.0, hmYMax_ = 1.0;
@@ -62,4 +76,8 @@ private:
     QString title_;
 
     QRectF lastPlotRect_;
+
+    // Everything paintEvent draws, at device resolution.
+    QPixmap cache_;
+    bool cacheValid_ = false;
 };
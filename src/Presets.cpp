@@ -0,0 +1,321 @@
+#include "Presets.h"
+#include <cmath>
+#include <cstdio>
+
+// Same formatting as QString::arg(v, 0, 'g', 17): round-trips every double exactly.
+static std::string num(double v)
+{
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.17g", v);
+    return buf;
+}
+
+static std::string makeWeierstrass2D()
+{
+    // Standard Weierstrass with a=0.5, b=3, kmax=20 (2D). Domain typically [-0.5, 0.5].
+    // f(x) = sum_i sum_k a^k cos(2*pi*b^k*(x_i+0.5)) - n*sum_k a^k cos(2*pi*b^k*0.5)
+    const int kmax = 20;
+    const double a = 0.5;
+    const double b = 3.0;
+    auto termForX = [&](const std::string& xi)->std::string{
+        std::string s;
+        for(int k=0;k<=kmax;k++){
+            const double ak = std::pow(a, k);
+            const double bk = std::pow(b, k);
+            if(k) s += " + ";
+            s += num(ak) + "*cos(2*pi*" + num(bk) + "*(" + xi + "+0.5))";
+        }
+        return "(" + s + ")";
+    };
+
+    std::string csum;
+    for(int k=0;k<=kmax;k++){
+        const double ak = std::pow(a, k);
+        const double bk = std::pow(b, k);
+        if(k) csum += " + ";
+        csum += num(ak) + "*cos(2*pi*" + num(bk) + "*0.5)";
+    }
+    const std::string base = termForX("x0") + " + " + termForX("x1");
+    return base + " - 2*(" + csum + ")";
+}
+
+static std::string makeHartmann3()
+{
+    // Hartmann 3D (classic definition), domain [0,1]^3.
+    // f(x) = -sum_{i=1..4} alpha_i * exp(-sum_{j=1..3} A_ij*(x_j - P_ij)^2)
+    const double alpha[4] = {1.0, 1.2, 3.0, 3.2};
+    const double A[4][3] = {
+        {3.0, 10.0, 30.0},
+        {0.1, 10.0, 35.0},
+        {3.0, 10.0, 30.0},
+        {0.1, 10.0, 35.0}
+    };
+    const double P[4][3] = {
+        {0.3689, 0.1170, 0.2673},
+        {0.4699, 0.4387, 0.7470},
+        {0.1091, 0.8732, 0.5547},
+        {0.0381, 0.5743, 0.8828}
+    };
+
+    std::string s;
+    for(int i=0;i<4;i++){
+        std::string inner;
+        for(int j=0;j<3;j++){
+            if(j) inner += " + ";
+            inner += num(A[i][j]) + "*(x" + std::to_string(j) + "-" + num(P[i][j]) + ")^2";
+        }
+        const std::string term = num(alpha[i]) + "*exp(-(" + inner + "))";
+        if(i) s += " + ";
+        s += term;
+    }
+    return "- (" + s + ")";
+}
+
+static std::string makeHartmann6()
+{
+    // Hartmann 6D (classic definition), domain [0,1]^6.
+    const double alpha[4] = {1.0, 1.2, 3.0, 3.2};
+    const double A[4][6] = {
+        {10.0, 3.0, 17.0, 3.5, 1.7, 8.0},
+        {0.05, 10.0, 17.0, 0.1, 8.0, 14.0},
+        {3.0, 3.5, 1.7, 10.0, 17.0, 8.0},
+        {17.0, 8.0, 0.05, 10.0, 0.1, 14.0}
+    };
+    const double P[4][6] = {
+        {0.1312, 0.1696, 0.5569, 0.0124, 0.8283, 0.5886},
+        {0.2329, 0.4135, 0.8307, 0.3736, 0.1004, 0.9991},
+        {0.2348, 0.1451, 0.3522, 0.2883, 0.3047, 0.6650},
+        {0.4047, 0.8828, 0.8732, 0.5743, 0.1091, 0.0381}
+    };
+
+    std::string s;
+    for(int i=0;i<4;i++){
+        std::string inner;
+        for(int j=0;j<6;j++){
+            if(j) inner += " + ";
+            inner += num(A[i][j]) + "*(x" + std::to_string(j) + "-" + num(P[i][j]) + ")^2";
+        }
+        const std::string term = num(alpha[i]) + "*exp(-(" + inner + "))";
+        if(i) s += " + ";
+        s += term;
+    }
+    return "- (" + s + ")";
+}
+
+static std::string makeShekel(int m)
+{
+    // Shekel family (m=5,7,10), 4D, domain [0,10]^4.
+    const double A[10][4] = {
+        {4.0, 4.0, 4.0, 4.0},
+        {1.0, 1.0, 1.0, 1.0},
+        {8.0, 8.0, 8.0, 8.0},
+        {6.0, 6.0, 6.0, 6.0},
+        {3.0, 7.0, 3.0, 7.0},
+        {2.0, 9.0, 2.0, 9.0},
+        {5.0, 5.0, 3.0, 3.0},
+        {8.0, 1.0, 8.0, 1.0},
+        {6.0, 2.0, 6.0, 2.0},
+        {7.0, 3.6, 7.0, 3.6}
+    };
+    const double C[10] = {0.1,0.2,0.2,0.4,0.4,0.6,0.3,0.7,0.5,0.5};
+
+    std::string s;
+    for(int i=0;i<m;i++){
+        std::string denom;
+        for(int j=0;j<4;j++){
+            if(j) denom += " + ";
+            denom += "(x" + std::to_string(j) + "-" + num(A[i][j]) + ")^2";
+        }
+        denom += " + " + num(C[i]);
+        const std::string term = "1/(" + denom + ")";
+        if(i) s += " + ";
+        s += term;
+    }
+    return "- (" + s + ")";
+}
+
+static std::vector<Preset> makePresets()
+{
+    std::vector<Preset> presets;
+
+    auto add = [&](const char* name, const std::string& expr, int dim, double lo, double hi){
+        presets.push_back({name, expr, dim, lo, hi});
+    };
+
+    // Analytic presets (supported by the expression parser)
+    add("rastrigin",
+        "20 + (x0^2 - 10*cos(2*pi*x0)) + (x1^2 - 10*cos(2*pi*x1))", 2, -5.12, 5.12);
+    add("rosenbrock",
+        "(1 - x0)^2 + 100*(x1 - x0^2)^2", 2, -2.048, 2.048);
+
+    // Framework-specific / not representable as a single analytic string (placeholder in standalone mode)
+    add("potential", std::string(), 2, -5.0, 5.0);
+
+    add("ackley",
+        "-20*exp(-0.2*sqrt(0.5*(x0^2+x1^2))) - exp(0.5*(cos(2*pi*x0)+cos(2*pi*x1))) + 20 + e", 2, -32.768, 32.768);
+    add("sphere",
+        "x0^2 + x1^2", 2, -5.12, 5.12);
+    add("griewank",
+        "1 + (x0^2 + x1^2)/4000 - cos(x0)*cos(x1/sqrt(2))", 2, -600.0, 600.0);
+
+    // Levy N.13 (2D)
+    add("levy",
+        "(sin(3*pi*x0))^2 + (x0-1)^2*(1 + (sin(3*pi*x1))^2) + (x1-1)^2*(1 + (sin(2*pi*x1))^2)", 2, -10.0, 10.0);
+
+    add("attractivesector", std::string(), 2, -5.0, 5.0);
+
+    add("bohachevsky1",
+        "x0^2 + 2*x1^2 - 0.3*cos(3*pi*x0) - 0.4*cos(4*pi*x1) + 0.7", 2, -100.0, 100.0);
+    add("bohachevsky2",
+        "x0^2 + 2*x1^2 - 0.3*cos(3*pi*x0)*cos(4*pi*x1) + 0.3", 2, -100.0, 100.0);
+    add("bohachevsky3",
+        "x0^2 + 2*x1^2 - 0.3*cos(3*pi*x0 + 4*pi*x1) + 0.3", 2, -100.0, 100.0);
+
+    // Branin (classic bounds are per-variable; here an envelope)
+    add("branin",
+        "(x1 - (5.1/(4*pi^2))*x0^2 + (5/pi)*x0 - 6)^2 + 10*(1 - 1/(8*pi))*cos(x0) + 10", 2, -5.0, 15.0);
+
+    // Six-hump camel (classic bounds are per-variable; here an envelope)
+    add("camel",
+        "((4 - 2.1*x0^2 + (x0^4)/3)*x0^2) + (x0*x1) + ((-4 + 4*x1^2)*x1^2)", 2, -3.0, 3.0);
+
+    add("cigar",
+        "x0^2 + 1000000*x1^2", 2, -100.0, 100.0);
+
+    // Cosine Mixture (common variant)
+    add("cosinemixture",
+        "x0^2 + x1^2 - 0.1*(cos(5*pi*x0) + cos(5*pi*x1))", 2, -1.0, 1.0);
+
+    add("differentpowers",
+        "(abs(x0))^2 + (abs(x1))^3", 2, -1.0, 1.0);
+
+    add("diracproblem", std::string(), 2, -5.0, 5.0);
+
+    add("easom",
+        "-cos(x0)*cos(x1)*exp(-((x0-pi)^2 + (x1-pi)^2))", 2, -100.0, 100.0);
+
+    // Ellipsoidal (2D specialization). Note: for n=2 it matches the common 1e6-conditioned ellipsoid.
+    add("ellipsoidal",
+        "x0^2 + 1000000*x1^2", 2, -5.0, 5.0);
+
+    add("equalmaxima",
+        "(sin(5*pi*x0))^6", 2, 0.0, 1.0);
+
+    // Exponential (common benchmark): f(x) = -exp(-0.5*sum x_i^2)
+    add("expotential",
+        "-exp(-0.5*(x0^2+x1^2))", 2, -1.0, 1.0);
+
+    add("goldstein",
+        "(1 + (x0 + x1 + 1)^2*(19 - 14*x0 + 3*x0^2 - 14*x1 + 6*x0*x1 + 3*x1^2))"
+        " * (30 + (2*x0 - 3*x1)^2*(18 - 32*x0 + 12*x0^2 + 48*x1 - 36*x0*x1 + 27*x1^2))",
+        2, -2.0, 2.0);
+
+    // Griewank-Rosenbrock (F8F2, 2D specialization)
+    add("griewankrosenbrock",
+        "(pow(100*(x0^2 - x1)^2 + (x0-1)^2,2)/4000) - cos(100*(x0^2 - x1)^2 + (x0-1)^2) + 1",
+        2, -5.0, 5.0);
+
+    // Hansen is not a single canonical definition across benchmark suites; keep placeholder in standalone mode.
+    add("hansen", std::string(), 2, -5.0, 5.0);
+
+    add("hartmann3", makeHartmann3(), 3, 0.0, 1.0);
+    add("hartmann6", makeHartmann6(), 6, 0.0, 1.0);
+
+    // Variants typically involve shifting/rotation in their canonical definitions.
+    // In standalone mode, they are kept as placeholders unless you provide the exact variant definition.
+    add("rastrigin2", std::string(), 2, -5.12, 5.12);
+    add("rotatedrosenbrock", std::string(), 2, -2.048, 2.048);
+
+    add("shekel5",  makeShekel(5), 4, 0.0, 10.0);
+    add("shekel7",  makeShekel(7), 4, 0.0, 10.0);
+    add("shekel10", makeShekel(10), 4, 0.0, 10.0);
+
+    add("shubert",
+        "(cos(2*x0 + 1) + 2*cos(3*x0 + 2) + 3*cos(4*x0 + 3) + 4*cos(5*x0 + 4) + 5*cos(6*x0 + 5))"
+        " * (cos(2*x1 + 1) + 2*cos(3*x1 + 2) + 3*cos(4*x1 + 3) + 4*cos(5*x1 + 4) + 5*cos(6*x1 + 5))",
+        2, -10.0, 10.0);
+
+    // Step-Ellipsoidal (2D specialization) using floor(x+0.5)
+    add("stepellipsoidal",
+        "floor(x0+0.5)^2 + 1000000*floor(x1+0.5)^2", 2, -5.0, 5.0);
+    add("test2n", std::string(), 2, -5.0, 5.0);
+    add("test30n", std::string(), 30, -5.0, 5.0);
+
+    add("antennaarray", std::string(), 2, -5.0, 5.0);
+    add("antennaula", std::string(), 2, -5.0, 5.0);
+    add("bifunctionalcatalyst", std::string(), 2, -5.0, 5.0);
+    add("bucherastrigin", std::string(), 2, -5.0, 5.0);
+    add("cassini", std::string(), 2, -5.0, 5.0);
+    add("ded1", std::string(), 2, -5.0, 5.0);
+    add("ded2", std::string(), 2, -5.0, 5.0);
+    add("eld1", std::string(), 2, -5.0, 5.0);
+    add("eld2", std::string(), 2, -5.0, 5.0);
+    add("eld3", std::string(), 2, -5.0, 5.0);
+    add("eld4", std::string(), 2, -5.0, 5.0);
+    add("eld5", std::string(), 2, -5.0, 5.0);
+    add("fmsynth", std::string(), 2, -5.0, 5.0);
+    add("gallagher101", std::string(), 2, -5.0, 5.0);
+    add("gallagher21", std::string(), 2, -5.0, 5.0);
+    add("heatexchanger", std::string(), 2, -5.0, 5.0);
+
+    add("himmelblau",
+        "(x0^2 + x1 - 11)^2 + (x0 + x1^2 - 7)^2", 2, -5.0, 5.0);
+
+    add("hydrothermal", std::string(), 2, -5.0, 5.0);
+    add("ik6dof", std::string(), 2, -5.0, 5.0);
+    add("katsuura", std::string(), 2, -5.0, 5.0);
+    add("lunacekbirastrigin", std::string(), 2, -5.0, 5.0);
+    add("messenger", std::string(), 2, -5.0, 5.0);
+
+    // Michalewicz (2D, m=10) - using a common 2D specialization
+    add("michalewicz",
+        "-(sin(x0) * (sin(1*x0^2/pi))^20 + sin(x1) * (sin(2*x1^2/pi))^20)", 2, 0.0, 3.141592653589793);
+
+    add("ofdmpower", std::string(), 2, -5.0, 5.0);
+    add("polyphase", std::string(), 2, -5.0, 5.0);
+    add("portfoliomv", std::string(), 2, -5.0, 5.0);
+
+    // Schaffer N.2
+    add("schaffer",
+        "0.5 + ((sin(x0^2 - x1^2))^2 - 0.5) / (1 + 0.001*(x0^2 + x1^2))^2", 2, -100.0, 100.0);
+
+    // Schwefel 2.26 (2D specialization)
+    add("schwefel",
+        "837.9658 - (x0*sin(sqrt(abs(x0))) + x1*sin(sqrt(abs(x1))))", 2, -500.0, 500.0);
+
+    add("tandem", std::string(), 2, -5.0, 5.0);
+    add("tersoffb", std::string(), 2, -5.0, 5.0);
+    add("tersoffc", std::string(), 2, -5.0, 5.0);
+    add("tnep", std::string(), 2, -5.0, 5.0);
+    add("transmissionpricing", std::string(), 2, -5.0, 5.0);
+    add("vibratingplatform", std::string(), 2, -5.0, 5.0);
+    add("weierstrass", makeWeierstrass2D(), 2, -0.5, 0.5);
+    add("wirelesscoverage", std::string(), 2, -5.0, 5.0);
+
+    add("zakharov",
+        "x0^2 + x1^2 + (0.5*(1*x0 + 2*x1))^2 + (0.5*(1*x0 + 2*x1))^4", 2, -5.0, 10.0);
+
+    add("sinusoidal", std::string(), 2, -5.0, 5.0);
+    add("gascycle", std::string(), 2, -5.0, 5.0);
+
+    add("gkls", std::string(), 2, -1.0, 1.0);
+    add("gkls250", std::string(), 2, -1.0, 1.0);
+    add("gkls350", std::string(), 2, -1.0, 1.0);
+    add("gkls2100", std::string(), 2, -1.0, 1.0);
+
+    return presets;
+}
+
+const std::vector<Preset>& builtinPresets()
+{
+    static const std::vector<Preset> presets = makePresets();
+    return presets;
+}
+
+const Preset* findPreset(const std::string& name)
+{
+    for(const auto& p : builtinPresets()){
+        if(p.name==name) return &p;
+    }
+    return nullptr;
+}
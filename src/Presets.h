@@ -0,0 +1,20 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// Built-in benchmark problems. An empty expression marks a framework-specific problem
+// that has no closed form in standalone mode (placeholder).
+struct Preset
+{
+    std::string name;
+    std::string expr;
+    int dim{2};
+    double lo{-5.0};
+    double hi{5.0};
+};
+
+// Full preset list in display order. Built once on first use.
+const std::vector<Preset>& builtinPresets();
+
+// Lookup by name; returns nullptr if there is no such preset.
+const Preset* findPreset(const std::string& name);
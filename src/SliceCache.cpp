@@ -0,0 +1,166 @@
+#include "SliceCache.h"
+#include "SliceStore.h"
+#include <algorithm>
+
+SliceKey SliceKey::of(const ObjectiveFunction& obj, const SliceSpec& spec)
+{
+    SliceKey k;
+    k.program = obj.fingerprint();
+    k.dim = spec.dim;
+    k.xAxis = spec.xAxis;
+    k.yAxis = spec.yAxis;
+    k.n = spec.n;
+
+    // "+ 0.0" turns -0.0 into 0.0, which compares equal and must hash equal.
+    auto at = [](const std::vector<double>& v, int i){
+        return (i>=0 && static_cast<size_t>(i)<v.size()) ? v[static_cast<size_t>(i)] + 0.0 : 0.0;
+    };
+    k.xLower = at(spec.lower, spec.xAxis);
+    k.xUpper = at(spec.upper, spec.xAxis);
+    k.yLower = at(spec.lower, spec.yAxis);
+    k.yUpper = at(spec.upper, spec.yAxis);
+    k.fixed.assign(static_cast<size_t>(std::max(spec.dim, 0)), 0.0);
+    for(int i=0;i<spec.dim;i++)
+        if(i!=spec.xAxis && i!=spec.yAxis) k.fixed[static_cast<size_t>(i)] = at(spec.fixed, i);
+    return k;
+}
+
+std::uint64_t SliceKey::hash() const
+{
+    // FNV-1a over the fields.
+    std::uint64_t h = 1469598103934665603ull;
+    auto mix = [&h](const void* p, std::size_t n){
+        const unsigned char* c = static_cast<const unsigned char*>(p);
+        for(std::size_t k=0;k<n;k++){ h ^= c[k]; h *= 1099511628211ull; }
+    };
+    mix(&program, sizeof(program));
+    const int ints[4] = {dim, xAxis, yAxis, n};
+    mix(ints, sizeof(ints));
+    const double bounds[4] = {xLower, xUpper, yLower, yUpper};
+    mix(bounds, sizeof(bounds));
+    if(!fixed.empty()) mix(fixed.data(), fixed.size()*sizeof(double));
+    return h;
+}
+
+bool SliceKey::operator==(const SliceKey& o) const
+{
+    return program==o.program && dim==o.dim && xAxis==o.xAxis && yAxis==o.yAxis && n==o.n
+        && xLower==o.xLower && xUpper==o.xUpper && yLower==o.yLower && yUpper==o.yUpper
+        && fixed==o.fixed;
+}
+
+SliceCache::SliceCache(std::size_t budgetBytes) : budget_(budgetBytes) {}
+
+std::size_t SliceCache::gridBytes(const HeightGrid& grid)
+{
+    return sizeof(HeightGrid) + (grid.z.capacity() + grid.dzdx.capacity() + grid.dzdy.capacity())*sizeof(double);
+}
+
+std::shared_ptr<const HeightGrid> SliceCache::find(const SliceKey& key)
+{
+    std::shared_ptr<SliceStore> store;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(key);
+        if(it != entries_.end()){
+            ++stats_.hits;
+            it->second.lastUse = ++use_;
+            return it->second.grid;
+        }
+        store = store_;
+    }
+
+    // The disk is read without holding the lock.
+    auto grid = std::make_shared<HeightGrid>();
+    const bool found = store && store->load(key, *grid);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(!found){
+        ++stats_.misses;
+        return nullptr;
+    }
+    ++stats_.diskHits;
+    insertLocked(key, grid);
+    return grid;
+}
+
+void SliceCache::insert(const SliceKey& key, std::shared_ptr<const HeightGrid> grid)
+{
+    if(!grid) return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    insertLocked(key, std::move(grid));
+}
+
+void SliceCache::persist(const SliceKey& key, const HeightGrid& grid)
+{
+    std::shared_ptr<SliceStore> store;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        store = store_;
+    }
+    if(store) store->save(key, grid);
+}
+
+void SliceCache::setStore(std::shared_ptr<SliceStore> store)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    store_ = std::move(store);
+}
+
+void SliceCache::insertLocked(const SliceKey& key, std::shared_ptr<const HeightGrid> grid)
+{
+    const std::size_t bytes = gridBytes(*grid);
+    auto it = entries_.find(key);
+    if(it != entries_.end()){
+        stats_.bytes -= it->second.bytes;
+        entries_.erase(it);
+    }
+    if(bytes > budget_) return;
+
+    evictTo(budget_ - bytes);
+    Entry& e = entries_[key];
+    e.grid = std::move(grid);
+    e.bytes = bytes;
+    e.lastUse = ++use_;
+    stats_.bytes += bytes;
+}
+
+void SliceCache::evictTo(std::size_t bytes)
+{
+    while(stats_.bytes > bytes && !entries_.empty()){
+        auto lru = entries_.begin();
+        for(auto e = entries_.begin(); e != entries_.end(); ++e)
+            if(e->second.lastUse < lru->second.lastUse) lru = e;
+        stats_.bytes -= lru->second.bytes;
+        ++stats_.evictions;
+        entries_.erase(lru);
+    }
+}
+
+void SliceCache::setBudget(std::size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    budget_ = bytes;
+    evictTo(budget_);
+}
+
+std::size_t SliceCache::budget() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return budget_;
+}
+
+void SliceCache::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    stats_.bytes = 0;
+}
+
+SliceCache::Stats SliceCache::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats s = stats_;
+    s.entries = entries_.size();
+    return s;
+}
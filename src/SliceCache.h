@@ -0,0 +1,92 @@
+#pragma once
+#include "GridSampler.h"
+#include "ObjectiveFunction.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+// Everything a sampled slice depends on: the compiled program, the slice axes and their
+// bounds, the values of the other variables and the grid size. Bounds of the other
+// variables and fixed values of the axes do not affect the samples and are left out, so
+// switching back to an earlier axis pair or preset finds its grid again.
+struct SliceKey
+{
+    std::uint64_t program{0};   // ObjectiveFunction::fingerprint()
+    int dim{0};
+    int xAxis{0}, yAxis{1};
+    int n{0};
+    double xLower{0.0}, xUpper{0.0}, yLower{0.0}, yUpper{0.0};
+    std::vector<double> fixed;  // dim values; the entries of the two axes are 0
+
+    static SliceKey of(const ObjectiveFunction& obj, const SliceSpec& spec);
+
+    std::uint64_t hash() const;
+    bool operator==(const SliceKey& o) const;
+    bool operator!=(const SliceKey& o) const { return !(*this == o); }
+};
+
+class SliceStore;
+
+// LRU cache of sampled height grids under a memory budget. Grids are immutable once
+// inserted and shared with the callers. Optionally backed by an on-disk SliceStore: memory
+// misses are looked up there, and inserted grids can be written through. Safe to use from
+// several threads.
+class SliceCache
+{
+public:
+    explicit SliceCache(std::size_t budgetBytes = kDefaultBudget);
+
+    static constexpr std::size_t kDefaultBudget = std::size_t(256) << 20;
+
+    // The cached grid for key, or null. Counts a hit or a miss; a grid found in the store
+    // counts as a disk hit and is kept in memory from then on.
+    std::shared_ptr<const HeightGrid> find(const SliceKey& key);
+
+    // Stores grid under key, evicting least recently used grids to stay within the budget.
+    // Grids larger than the whole budget are not kept in memory.
+    void insert(const SliceKey& key, std::shared_ptr<const HeightGrid> grid);
+
+    // Writes grid to the store, if there is one. This is file I/O; call it off the
+    // latency-critical path.
+    void persist(const SliceKey& key, const HeightGrid& grid);
+
+    // Attaches (or, with null, detaches) the on-disk store.
+    void setStore(std::shared_ptr<SliceStore> store);
+
+    // Shrinking the budget evicts immediately; 0 disables the cache.
+    void setBudget(std::size_t bytes);
+    std::size_t budget() const;
+    void clear();
+
+    struct Stats {
+        std::uint64_t hits{0}, diskHits{0}, misses{0}, evictions{0};
+        std::size_t entries{0};
+        std::size_t bytes{0};
+    };
+    Stats stats() const;
+
+    // Memory charged for one grid.
+    static std::size_t gridBytes(const HeightGrid& grid);
+
+private:
+    struct KeyHash {
+        std::size_t operator()(const SliceKey& k) const { return static_cast<std::size_t>(k.hash()); }
+    };
+    struct Entry {
+        std::shared_ptr<const HeightGrid> grid;
+        std::size_t bytes{0};
+        std::uint64_t lastUse{0};
+    };
+
+    void evictTo(std::size_t bytes);   // callers hold mutex_
+    void insertLocked(const SliceKey& key, std::shared_ptr<const HeightGrid> grid);
+
+    mutable std::mutex mutex_;
+    std::unordered_map<SliceKey, Entry, KeyHash> entries_;
+    std::size_t budget_;
+    std::shared_ptr<SliceStore> store_;
+    std::uint64_t use_{0};
+    Stats stats_;
+};
@@ -0,0 +1,127 @@
+#include "SliceMinimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <queue>
+
+SliceMinimizer::SliceMinimizer(const ObjectiveFunction& obj, const SliceSpec& spec)
+    : obj_(obj), spec_(spec), valid_(obj.dimension()==spec.dim && spec.dim>0),
+      best_(std::numeric_limits<double>::infinity())
+{
+    const size_t d = static_cast<size_t>(std::max(spec_.dim, 0));
+    if(spec_.fixed.size() != d) spec_.fixed.assign(d, 0.0);
+    box_.resize(d);
+    point_ = spec_.fixed;
+    for(size_t k=0;k<d;k++) box_[k] = {spec_.fixed[k], spec_.fixed[k]};
+}
+
+ObjectiveFunction::Interval SliceMinimizer::boundBox(const Box& b)
+{
+    box_[static_cast<size_t>(spec_.xAxis)] = {b.x0, b.x1};
+    box_[static_cast<size_t>(spec_.yAxis)] = {b.y0, b.y1};
+    return obj_.evaluateInterval(box_.data());
+}
+
+ObjectiveFunction::Interval SliceMinimizer::enclosure() const
+{
+    if(!valid_) return {std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity()};
+    std::vector<ObjectiveFunction::Interval> box = box_;
+    const size_t ax = static_cast<size_t>(spec_.xAxis), ay = static_cast<size_t>(spec_.yAxis);
+    box[ax] = {spec_.lower[ax], spec_.upper[ax]};
+    box[ay] = {spec_.lower[ay], spec_.upper[ay]};
+    return obj_.evaluateInterval(box.data());
+}
+
+void SliceMinimizer::tryPoint(double x, double y)
+{
+    point_[static_cast<size_t>(spec_.xAxis)] = x;
+    point_[static_cast<size_t>(spec_.yAxis)] = y;
+    const double v = obj_.evaluate(point_.data());
+    if(std::isfinite(v) && v < best_){
+        best_ = v;
+        bestX_ = x;
+        bestY_ = y;
+    }
+}
+
+void SliceMinimizer::addCandidate(double x, double y)
+{
+    if(valid_) tryPoint(x, y);
+}
+
+void SliceMinimizer::addCandidates(const HeightGrid& grid)
+{
+    // The samples went through displayValue(), so the point is evaluated again.
+    const int N = grid.n;
+    if(N<2 || grid.z.size() != static_cast<size_t>(N)*static_cast<size_t>(N)) return;
+    const size_t k = static_cast<size_t>(std::min_element(grid.z.begin(), grid.z.end()) - grid.z.begin());
+    const size_t ax = static_cast<size_t>(spec_.xAxis), ay = static_cast<size_t>(spec_.yAxis);
+    const double tx = double(k % static_cast<size_t>(N)) / (N-1);
+    const double ty = double(k / static_cast<size_t>(N)) / (N-1);
+    addCandidate(spec_.lower[ax] + (spec_.upper[ax]-spec_.lower[ax])*tx,
+                 spec_.lower[ay] + (spec_.upper[ay]-spec_.lower[ay])*ty);
+}
+
+SliceMinimizer::Result SliceMinimizer::minimize(std::size_t maxBoxes, double tolerance, const std::atomic<bool>* cancel)
+{
+    constexpr double kInf = std::numeric_limits<double>::infinity();
+    Result r;
+    if(!valid_) return r;
+
+    const size_t ax = static_cast<size_t>(spec_.xAxis), ay = static_cast<size_t>(spec_.yAxis);
+    const double spanX = spec_.upper[ax] - spec_.lower[ax];
+    const double spanY = spec_.upper[ay] - spec_.lower[ay];
+
+    auto later = [](const Box& a, const Box& b){ return a.lower > b.lower; };
+    std::priority_queue<Box, std::vector<Box>, decltype(later)> open(later);
+    // Smallest lower bound among boxes that were dropped rather than split further.
+    double dropped = kInf;
+
+    auto visit = [&](Box b){
+        const ObjectiveFunction::Interval f = boundBox(b);
+        r.boxes++;
+        if(f.empty()) return;   // f is defined nowhere in b
+        tryPoint(0.5*(b.x0+b.x1), 0.5*(b.y0+b.y1));
+        b.lower = f.lo;
+        if(b.lower > best_ - tolerance) dropped = std::min(dropped, b.lower);
+        else open.push(b);
+    };
+    visit({spec_.lower[ax], spec_.upper[ax], spec_.lower[ay], spec_.upper[ay], 0.0});
+
+    while(!open.empty() && r.boxes < maxBoxes){
+        if(cancel && cancel->load(std::memory_order_relaxed)) break;
+        const Box b = open.top();
+        open.pop();
+        // Boxes pushed before a better value was found may now be out.
+        if(b.lower > best_ - tolerance){
+            dropped = std::min(dropped, b.lower);
+            continue;
+        }
+
+        // Halve the side that is longer relative to its axis; boxes at the resolution of
+        // doubles cannot be split and keep their bound.
+        const double wx = (b.x1 - b.x0) / spanX, wy = (b.y1 - b.y0) / spanY;
+        if(std::max(wx, wy) < 1e-13){
+            dropped = std::min(dropped, b.lower);
+            continue;
+        }
+        if(wx >= wy){
+            const double m = 0.5*(b.x0 + b.x1);
+            visit({b.x0, m, b.y0, b.y1, 0.0});
+            visit({m, b.x1, b.y0, b.y1, 0.0});
+        } else {
+            const double m = 0.5*(b.y0 + b.y1);
+            visit({b.x0, b.x1, b.y0, m, 0.0});
+            visit({b.x0, b.x1, m, b.y1, 0.0});
+        }
+    }
+
+    r.defined = std::isfinite(best_);
+    r.upper = best_;
+    r.x = bestX_;
+    r.y = bestY_;
+    r.lower = std::min(dropped, open.empty() ? kInf : open.top().lower);
+    if(r.defined) r.lower = std::min(r.lower, r.upper);
+    r.converged = r.defined && r.upper - r.lower <= tolerance;
+    return r;
+}
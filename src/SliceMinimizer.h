@@ -0,0 +1,61 @@
+#pragma once
+#include "GridSampler.h"
+#include "ObjectiveFunction.h"
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Global minimum of a slice by interval branch and bound. The slice rectangle is split into
+// boxes, best lower bound first; ObjectiveFunction::evaluateInterval() bounds f over each
+// box, and boxes whose bound lies above the best value found so far (at box centres or
+// seeded points) are discarded because they cannot contain the minimum. What is left bounds
+// the minimum from below, so the result is certified up to the rounding assumptions of
+// evaluateInterval():
+//
+//   lower <= min f over the slice <= upper = f(x, y)
+//
+// Points at which f is not defined (NaN) are ignored.
+class SliceMinimizer
+{
+public:
+    SliceMinimizer(const ObjectiveFunction& obj, const SliceSpec& spec);
+
+    // Bounds for f over the whole slice rectangle, without any splitting.
+    ObjectiveFunction::Interval enclosure() const;
+
+    // Makes (x, y) a candidate for the minimum; typically the smallest sample of a grid.
+    void addCandidate(double x, double y);
+    // addCandidate() for the smallest finite sample of grid (sampled over the same slice).
+    void addCandidates(const HeightGrid& grid);
+
+    struct Result {
+        double lower{0.0};      // f >= lower everywhere on the slice where f is defined
+        double upper{0.0};      // f(x, y), the smallest value found
+        double x{0.0}, y{0.0};
+        std::size_t boxes{0};   // interval evaluations
+        bool converged{false};  // upper - lower <= tolerance
+        bool defined{false};    // false: no point with a finite value was found
+    };
+
+    // Splits boxes until the gap between the bounds is at most `tolerance` or maxBoxes
+    // interval evaluations have been spent; the bounds are valid either way. `cancel` is
+    // polled per box; a cancelled search returns the bounds reached so far.
+    Result minimize(std::size_t maxBoxes, double tolerance, const std::atomic<bool>* cancel = nullptr);
+
+private:
+    struct Box {
+        double x0, x1, y0, y1;
+        double lower;
+    };
+
+    ObjectiveFunction::Interval boundBox(const Box& b);
+    void tryPoint(double x, double y);
+
+    const ObjectiveFunction& obj_;
+    SliceSpec spec_;
+    bool valid_{false};
+    std::vector<ObjectiveFunction::Interval> box_;   // fixed variables as point intervals
+    std::vector<double> point_;
+    double best_;
+    double bestX_{0.0}, bestY_{0.0};
+};
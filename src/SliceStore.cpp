@@ -0,0 +1,299 @@
+#include "SliceStore.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define FVT_SLICE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr char kMagic[4] = {'F', 'V', 'T', 'S'};
+constexpr std::uint32_t kVersion = 2;   // 2: the checksum covers the header
+constexpr std::size_t kFixedHeader = 96;   // bytes before fixed[dim]
+constexpr std::size_t kChecksumOffset = 88;
+constexpr const char* kSuffix = ".fvts";
+
+template <class T>
+void put(std::vector<char>& out, T v)
+{
+    const char* p = reinterpret_cast<const char*>(&v);
+    out.insert(out.end(), p, p + sizeof(T));
+}
+
+template <class T>
+T get(const unsigned char* data, std::size_t offset)
+{
+    T v;
+    std::memcpy(&v, data + offset, sizeof(T));
+    return v;
+}
+
+// Steps of SliceStore::checksum(), shared with the copying pass in SliceStore::load().
+inline std::uint64_t checksumStep(std::uint64_t h, std::uint64_t w)
+{
+    h = (h ^ w) * 1099511628211ull;
+    return h ^ (h >> 29);
+}
+
+inline std::uint64_t checksumFinish(std::uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    return h ^ (h >> 33);
+}
+
+constexpr std::uint64_t kChecksumSeed = 1469598103934665603ull;
+
+// Folds every header word except the checksum itself into h.
+std::uint64_t checksumHeader(std::uint64_t h, const unsigned char* header, std::size_t bytes)
+{
+    for(std::size_t at=0; at+8<=bytes; at+=8){
+        if(at==kChecksumOffset) continue;
+        h = checksumStep(h, get<std::uint64_t>(header, at));
+    }
+    return h;
+}
+
+// Read-only view of a whole file: mmap where available, otherwise a copy in memory.
+class FileView
+{
+public:
+    explicit FileView(const std::string& path)
+    {
+#if defined(FVT_SLICE_MMAP)
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0) return;
+        struct stat st;
+        if(::fstat(fd, &st)==0 && st.st_size > 0){
+            void* p = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if(p != MAP_FAILED){
+                // One sequential pass follows.
+                ::madvise(p, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+                data_ = static_cast<const unsigned char*>(p);
+                size_ = static_cast<size_t>(st.st_size);
+            }
+        }
+        ::close(fd);
+#else
+        std::FILE* f = std::fopen(path.c_str(), "rb");
+        if(!f) return;
+        std::error_code ec;
+        const auto size = fs::file_size(path, ec);
+        if(!ec && size > 0){
+            copy_.resize(static_cast<size_t>(size));
+            if(std::fread(copy_.data(), 1, copy_.size(), f) == copy_.size()){
+                data_ = copy_.data();
+                size_ = copy_.size();
+            }
+        }
+        std::fclose(f);
+#endif
+    }
+    ~FileView()
+    {
+#if defined(FVT_SLICE_MMAP)
+        if(data_) ::munmap(const_cast<unsigned char*>(data_), size_);
+#endif
+    }
+    FileView(const FileView&) = delete;
+    FileView& operator=(const FileView&) = delete;
+
+    const unsigned char* data() const { return data_; }
+    std::size_t size() const { return size_; }
+
+private:
+    const unsigned char* data_{nullptr};
+    std::size_t size_{0};
+#if !defined(FVT_SLICE_MMAP)
+    std::vector<unsigned char> copy_;
+#endif
+};
+
+} // namespace
+
+SliceStore::SliceStore(std::string directory, std::uint64_t budgetBytes)
+    : dir_(std::move(directory)), budget_(budgetBytes)
+{
+    std::error_code ec;
+    fs::create_directories(dir_, ec);
+}
+
+void SliceStore::setBudget(std::uint64_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    budget_ = bytes;
+    evictTo(budget_);
+}
+
+std::uint64_t SliceStore::checksum(const unsigned char* header, std::size_t headerBytes,
+                                   const double* z, std::size_t count)
+{
+    // Word-wise FNV-1a variant with a final avalanche; fast enough to run on every load.
+    std::uint64_t h = checksumHeader(kChecksumSeed, header, headerBytes);
+    for(std::size_t k=0;k<count;k++){
+        std::uint64_t w;
+        std::memcpy(&w, z + k, sizeof(w));
+        h = checksumStep(h, w);
+    }
+    return checksumFinish(h);
+}
+
+std::string SliceStore::pathFor(const SliceKey& key) const
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key.hash()));
+    return (fs::path(dir_) / (std::string(name) + kSuffix)).string();
+}
+
+bool SliceStore::load(const SliceKey& key, HeightGrid& grid)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const std::string path = pathFor(key);
+    std::error_code ec;
+    if(!fs::exists(path, ec)) return false;
+
+    bool ok = false;
+    {
+        const FileView view(path);
+        const unsigned char* d = view.data();
+        const std::size_t n = static_cast<size_t>(std::max(key.n, 0));
+        const std::size_t dim = key.fixed.size();
+        const std::size_t header = kFixedHeader + 8*dim;
+        const std::size_t count = n*n;
+
+        // Every key field must match: files are named by a 64-bit hash only.
+        ok = d && view.size() == header + 8*count
+            && std::memcmp(d, kMagic, 4)==0
+            && get<std::uint32_t>(d, 4)==kVersion
+            && get<std::uint32_t>(d, 8)==header
+            && get<std::uint32_t>(d, 12)==static_cast<std::uint32_t>(key.n)
+            && get<std::int32_t>(d, 16)==key.dim
+            && get<std::int32_t>(d, 20)==key.xAxis
+            && get<std::int32_t>(d, 24)==key.yAxis
+            && get<std::uint64_t>(d, 32)==key.program
+            && get<double>(d, 40)==key.xLower && get<double>(d, 48)==key.xUpper
+            && get<double>(d, 56)==key.yLower && get<double>(d, 64)==key.yUpper;
+        for(std::size_t k=0; ok && k<dim; k++)
+            ok = get<double>(d, kFixedHeader + 8*k)==key.fixed[k];
+
+        if(ok){
+            grid.n = key.n;
+            grid.zMin = get<double>(d, 72);
+            grid.zMax = get<double>(d, 80);
+            // One pass over the mapping: copy out and checksum each height.
+            grid.z.resize(count);
+            const unsigned char* src = d + header;
+            double* dst = grid.z.data();
+            std::uint64_t h = checksumHeader(kChecksumSeed, d, header);
+            for(std::size_t k=0;k<count;k++){
+                std::uint64_t w;
+                std::memcpy(&w, src + 8*k, sizeof(w));
+                std::memcpy(dst + k, &w, sizeof(w));
+                h = checksumStep(h, w);
+            }
+            ok = checksumFinish(h)==get<std::uint64_t>(d, kChecksumOffset);
+        }
+    }
+
+    if(!ok){
+        fs::remove(path, ec);
+        return false;
+    }
+    // Mark as recently used for eviction.
+    fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+    return true;
+}
+
+bool SliceStore::save(const SliceKey& key, const HeightGrid& grid)
+{
+    const std::size_t count = static_cast<size_t>(grid.n)*static_cast<size_t>(grid.n);
+    if(grid.n != key.n || grid.z.size() != count) return false;
+    const std::size_t dim = key.fixed.size();
+
+    std::vector<char> header;
+    header.insert(header.end(), kMagic, kMagic + 4);
+    put<std::uint32_t>(header, kVersion);
+    put<std::uint32_t>(header, static_cast<std::uint32_t>(kFixedHeader + 8*dim));
+    put<std::uint32_t>(header, static_cast<std::uint32_t>(key.n));
+    put<std::int32_t>(header, key.dim);
+    put<std::int32_t>(header, key.xAxis);
+    put<std::int32_t>(header, key.yAxis);
+    put<std::uint32_t>(header, 0);
+    put<std::uint64_t>(header, key.program);
+    put<double>(header, key.xLower);
+    put<double>(header, key.xUpper);
+    put<double>(header, key.yLower);
+    put<double>(header, key.yUpper);
+    put<double>(header, grid.zMin);
+    put<double>(header, grid.zMax);
+    put<std::uint64_t>(header, 0);   // checksum, filled in below
+    for(double v : key.fixed) put<double>(header, v);
+    const std::uint64_t sum = checksum(reinterpret_cast<const unsigned char*>(header.data()), header.size(),
+                                       grid.z.data(), count);
+    std::memcpy(header.data() + kChecksumOffset, &sum, sizeof(sum));
+
+    const std::uint64_t bytes = header.size() + 8*count;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(bytes > budget_) return false;
+
+    const std::string path = pathFor(key);
+    const std::string tmp = path + ".tmp";
+    std::FILE* f = std::fopen(tmp.c_str(), "wb");
+    if(!f) return false;
+    bool ok = std::fwrite(header.data(), 1, header.size(), f) == header.size();
+    ok = ok && std::fwrite(grid.z.data(), 8, count, f) == count;
+    ok = std::fclose(f)==0 && ok;
+
+    std::error_code ec;
+    if(ok){
+        // Room for the new file (an older copy of it is replaced).
+        fs::remove(path, ec);
+        evictTo(budget_ - bytes);
+        fs::rename(tmp, path, ec);
+        ok = !ec;
+    }
+    if(!ok) fs::remove(tmp, ec);
+    return ok;
+}
+
+std::uint64_t SliceStore::diskBytes() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::uint64_t total = 0;
+    std::error_code ec;
+    for(const auto& e : fs::directory_iterator(dir_, ec))
+        if(e.path().extension()==kSuffix) total += e.file_size(ec);
+    return total;
+}
+
+void SliceStore::evictTo(std::uint64_t bytes)
+{
+    struct File { fs::path path; std::uint64_t size; fs::file_time_type used; };
+    std::vector<File> files;
+    std::uint64_t total = 0;
+    std::error_code ec;
+    for(const auto& e : fs::directory_iterator(dir_, ec)){
+        if(e.path().extension()!=kSuffix) continue;
+        File f{e.path(), e.file_size(ec), e.last_write_time(ec)};
+        total += f.size;
+        files.push_back(std::move(f));
+    }
+    if(total <= bytes) return;
+
+    std::sort(files.begin(), files.end(), [](const File& a, const File& b){ return a.used < b.used; });
+    for(const File& f : files){
+        if(total <= bytes) break;
+        if(fs::remove(f.path, ec)) total -= f.size;
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include "GridSampler.h"
+#include "SliceCache.h"
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+// On-disk slice store behind SliceCache: one file per SliceKey in a directory, named after
+// SliceKey::hash(). Files are memory-mapped for reading. A hit copies the heights out of the
+// mapping into the HeightGrid in one pass that also verifies the checksum, so it costs the
+// page faults plus one n×n copy; the grid does not keep referring to the file.
+//
+// File layout (native byte order; other byte orders fail the key check):
+//   char[4]  "FVTS"
+//   uint32   version (2)
+//   uint32   header bytes (offset of the heights, a multiple of 8)
+//   uint32   n
+//   int32    dim, xAxis, yAxis
+//   uint32   reserved (0)
+//   uint64   program fingerprint
+//   float64  xLower, xUpper, yLower, yUpper
+//   float64  zMin, zMax
+//   uint64   checksum of the other header fields and the heights (SliceStore::checksum)
+//   float64  fixed[dim]
+//   float64  heights[n*n], row-major as in HeightGrid
+//
+// The directory is kept under a byte budget: writing a slice removes the least recently
+// used files (by modification time, which a hit refreshes) until it fits.
+class SliceStore
+{
+public:
+    SliceStore(std::string directory, std::uint64_t budgetBytes = kDefaultBudget);
+
+    static constexpr std::uint64_t kDefaultBudget = std::uint64_t(2) << 30;
+
+    const std::string& directory() const { return dir_; }
+    void setBudget(std::uint64_t bytes);
+
+    // Reads the slice for key into grid. Returns false if there is none; a file whose key
+    // does not match or whose checksum fails is deleted.
+    bool load(const SliceKey& key, HeightGrid& grid);
+
+    // Writes grid under key (to a temporary file that is then renamed into place) and
+    // evicts old slices to stay within the budget. Returns false on I/O errors or if the
+    // slice alone exceeds the budget.
+    bool save(const SliceKey& key, const HeightGrid& grid);
+
+    // Bytes in slice files currently on disk.
+    std::uint64_t diskBytes() const;
+
+    // Checksum of a slice file: every 8-byte header word except the checksum field, then
+    // the heights.
+    static std::uint64_t checksum(const unsigned char* header, std::size_t headerBytes,
+                                  const double* z, std::size_t count);
+
+private:
+    std::string pathFor(const SliceKey& key) const;
+    void evictTo(std::uint64_t bytes);   // callers hold mutex_
+
+    mutable std::mutex mutex_;
+    std::string dir_;
+    std::uint64_t budget_;
+};
@@ -1,13 +1,85 @@
 #include "SurfaceWidget.h"
+#include "GridSampler.h"
+#include "ThreadPool.h"
+#include <QOpenGLContext>
 #include <QMouseEvent>
 #include <QWheelEvent>
 #include <QMessageBox>
 #include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <limits>
 
 static float clampf(float v, float a, float b){ return (v<a)?a:(v>b)?b:v; }
 
+// Entry of a GL object cache with the smallest lastUse.
+template <class Map>
+static typename Map::iterator leastRecentlyUsed(Map& cache)
+{
+    auto lru = cache.begin();
+    for(auto e = cache.begin(); e != cache.end(); ++e)
+        if(e->second.lastUse < lru->second.lastUse) lru = e;
+    return lru;
+}
+
+// Mesh heights lie in [-kHeightRange, kHeightRange] (buildMeshCPU scales the [-0.5, 0.5]
+// normalised value by 1.8); the compact layout stores pz / kHeightRange.
+static constexpr float kHeightRange = 0.9f;
+
+static std::int16_t snorm16(float v){ return static_cast<std::int16_t>(std::lround(clampf(v, -1.f, 1.f)*32767.f)); }
+
+// Grid index i of N as a normalised unsigned short; the shader maps it back to [-1, 1].
+static std::uint16_t gridCoord16(int i, int N)
+{
+    return static_cast<std::uint16_t>((static_cast<std::int64_t>(i)*65535 + (N-1)/2) / (N-1));
+}
+
+// Octahedral encoding of a unit normal; decoded by octDecode() in kCompactVs.
+static void octEncode(float nx, float ny, float nz, std::int16_t& ox, std::int16_t& oy)
+{
+    const float l1 = std::fabs(nx) + std::fabs(ny) + std::fabs(nz);
+    float u = nx/l1, v = ny/l1;
+    if(nz < 0.f){
+        const float fu = (1.f - std::fabs(v)) * (u >= 0.f ? 1.f : -1.f);
+        const float fv = (1.f - std::fabs(u)) * (v >= 0.f ? 1.f : -1.f);
+        u = fu; v = fv;
+    }
+    ox = snorm16(u);
+    oy = snorm16(v);
+}
+
+// Colour ramp on the normalised height t in [0, 1] (blue -> green -> yellow); kHeightRampGlsl
+// is the same ramp for the heightmap shader.
+static void heightRamp(float t, float& r, float& g, float& b)
+{
+    t = clampf(t, 0.f, 1.f);
+    r = clampf(1.4f*(t-0.5f), 0.f, 1.f);
+    g = clampf(1.2f*(1.f-std::fabs(2.f*t-1.f)), 0.f, 1.f);
+    b = clampf(1.0f - 1.2f*t, 0.f, 1.f);
+}
+
+// Index of the only fixed value in which two slice keys differ, or -1.
+static int changedFixedValue(const SliceKey& a, const SliceKey& b)
+{
+    if(a.program!=b.program || a.dim!=b.dim || a.xAxis!=b.xAxis || a.yAxis!=b.yAxis || a.n!=b.n
+       || a.xLower!=b.xLower || a.xUpper!=b.xUpper || a.yLower!=b.yLower || a.yUpper!=b.yUpper
+       || a.fixed.size()!=b.fixed.size()){
+        return -1;
+    }
+    int changed = -1;
+    for(size_t k=0;k<a.fixed.size();k++){
+        if(a.fixed[k]==b.fixed[k]) continue;
+        if(changed>=0) return -1;
+        changed = static_cast<int>(k);
+    }
+    return changed;
+}
+
+// Adaptive sampling stops refining once no leaf's error estimate exceeds this fraction of
+// the value range. Coarser values stop smooth surfaces (Zakharov, Hartmann) well short of
+// the accuracy of the uniform grid.
+static constexpr double kAdaptiveTolerance = 1e-5;
+
 SurfaceWidget::SurfaceWidget(QWidget* parent) : QOpenGLWidget(parent)
 {
     setFocusPolicy(Qt::StrongFocus);
@@ -17,10 +89,17 @@ SurfaceWidget::SurfaceWidget(QWidget* parent) : QOpenGLWidget(parent)
     lower_ = {-5.12, -5.12};
     upper_ = { 5.12,  5.12};
     fixed_ = {0.0, 0.0};
+
+    // Rebuilds run one at a time; the grid sampling inside a job fans out on ThreadPool::global().
+    rebuildPool_.setMaxThreadCount(1);
 }
 
 SurfaceWidget::~SurfaceWidget()
 {
+    if(cancel_) cancel_->store(true);
+    rebuildPool_.clear();
+    rebuildPool_.waitForDone();
+
     makeCurrent();
     clearGL();
     doneCurrent();
@@ -33,22 +112,220 @@ void SurfaceWidget::setGridN(int n){ gridN_ = n; }
 void SurfaceWidget::setBounds(const std::vector<double>& lower, const std::vector<double>& upper){ lower_=lower; upper_=upper; }
 void SurfaceWidget::setFixed(const std::vector<double>& fixed){ fixed_=fixed; }
 void SurfaceWidget::setWireframe(bool w){ wireframe_=w; }
-void SurfaceWidget::setZScale(double s){ zScale_=s; }
+void SurfaceWidget::setZScale(double s){ zScale_=s; fitDistance(); }
+void SurfaceWidget::setHeightmapMode(bool on){ heightmap_=on; }
+void SurfaceWidget::setCompactVertices(bool on){ compact_=on; }
+void SurfaceWidget::setStripIndices(bool on){ strips_=on; }
+void SurfaceWidget::setAdaptiveSampling(bool on){ adaptive_=on; }
+void SurfaceWidget::setExactNormals(bool on){ exactNormals_=on; }
+void SurfaceWidget::setContourLevels(int levels){ contourLevels_=std::max(0, levels); }
+void SurfaceWidget::setTopView(bool on){ topView_=on; }
+std::size_t SurfaceWidget::evaluations() const { return mesh_ ? mesh_->evaluations : 0; }
+SurfaceWidget::SampledSlice SurfaceWidget::sampledSlice() const { return mesh_ ? mesh_->slice : SampledSlice(); }
+void SurfaceWidget::setSliceCacheBudget(std::size_t bytes){ sliceCache_.setBudget(bytes); }
+SliceCache::Stats SurfaceWidget::sliceCacheStats() const { return sliceCache_.stats(); }
+
+void SurfaceWidget::setSliceStore(const std::string& directory, std::uint64_t budgetBytes)
+{
+    sliceCache_.setStore(directory.empty() ? nullptr : std::make_shared<SliceStore>(directory, budgetBytes));
+}
+
+SurfaceWidget::MemoryStats SurfaceWidget::memoryStats() const
+{
+    if(!mesh_) return MemoryStats();
+    const bool heights = !mesh_->heights.empty();
+    MemoryStats m;
+    if(heights){
+        m.textureBytes = qint64(heightN_)*qint64(heightN_)*qint64(sizeof(float));
+        auto it = gridCache_.find(heightN_);
+        if(it != gridCache_.end()) m.vertexBytes = it->second.vertexBytes;
+    } else {
+        m = meshMemory_;
+        if(meshIndexCount_ > 0) return m;   // adaptive mesh: its own index buffer
+    }
+    auto it = indexCache_.find({heights ? heightN_ : meshN_, strips_});
+    if(it != indexCache_.end()) m.indexBytes = it->second.bytes;
+    return m;
+}
 
 void SurfaceWidget::rebuildSurface()
 {
-    buildMeshCPU();
+    // Cancel the running job (it stops at the next row) and drop any queued one.
+    if(cancel_) cancel_->store(true);
+    cancel_ = std::make_shared<std::atomic<bool>>(false);
+    rebuildPool_.clear();
+
+    auto params = std::make_shared<RebuildParams>();
+    params->obj = obj_;
+    params->spec.dim = dim_;
+    params->spec.xAxis = xAxis_;
+    params->spec.yAxis = yAxis_;
+    params->spec.n = gridN_;
+    params->spec.lower = lower_;
+    params->spec.upper = upper_;
+    params->spec.fixed = fixed_;
+    params->heightmap = heightmap_;
+    params->compact = compact_;
+    params->adaptive = adaptive_;
+    params->exactNormals = exactNormals_;
+    params->contourLevels = contourLevels_;
+    // Previews cost a mesh build and upload each; a slice that rebuilds within a frame or
+    // two is better shown only once.
+    params->previews = lastRebuildMs_ < 0.0 || lastRebuildMs_ > kPreviewAfterMs;
+
+    const quint64 generation = ++generation_;
+    rebuildTimer_.start();
+    firstLevelMs_ = -1.0;
+    inFlight_ = true;
+
+    auto cancel = cancel_;
+    rebuildPool_.start([this, params, cancel, generation]{
+        // Queued to the GUI thread; dropped by Qt if the widget is gone by then.
+        auto post = [this, generation](std::shared_ptr<const MeshSnapshot> mesh, bool final){
+            QMetaObject::invokeMethod(this, [this, mesh, generation, final]{ onMeshReady(mesh, generation, final); },
+                                      Qt::QueuedConnection);
+        };
+        // Once the final mesh is out: certified bounds for the minimum of the slice, starting
+        // from the smallest sample (if any). A newer rebuild cancels the search.
+        auto boundMinimum = [this, params, cancel, generation](const HeightGrid* seed, double zRange){
+            SliceMinimizer minimizer(params->obj, params->spec);
+            if(seed) minimizer.addCandidates(*seed);
+            const SliceMinimizer::Result r =
+                minimizer.minimize(kMinimumBoxes, kMinimumTolerance*std::max(1.0, zRange), cancel.get());
+            if(cancel->load()) return;
+            QMetaObject::invokeMethod(this, [this, r, generation]{
+                if(generation == generation_) emit minimumBounded(r.lower, r.upper, r.x, r.y, r.converged);
+            }, Qt::QueuedConnection);
+        };
+
+        if(params->adaptive){
+            // At most the N×N evaluations of the uniform grid, spent in three stages of growing
+            // budget and stopped early once the tolerance is met; each stage continues the same
+            // tree and is shown as soon as it is meshed. The lattice is twice as fine as the
+            // grid, so sharp features can be resolved beyond it.
+            const int N = params->spec.n;
+            int depth = 1;
+            while((1 << depth) < N-1) depth++;
+            AdaptiveSampler sampler(params->obj, params->spec, depth + 1);
+            const std::size_t budget = std::max<std::size_t>(1024, static_cast<size_t>(N)*static_cast<size_t>(N));
+            for(std::size_t stage : {budget/16, budget/4, budget}){
+                if(stage!=budget && !params->previews) continue;
+                if(!sampler.refine(stage, kAdaptiveTolerance, cancel.get())) return;
+                // Stopping short of the stage budget means the tolerance was met.
+                const bool done = stage==budget || sampler.evaluations() < stage;
+                double zMin=0.0, zMax=1.0;
+                displayRange(sampler.lo(), sampler.hi(), zMin, zMax);
+                post(buildAdaptiveMeshCPU(sampler.triangulate(), N, sampler.evaluations(), zMin, zMax, params->compact),
+                     done);
+                if(done) break;
+            }
+            boundMinimum(nullptr, sampler.hi() - sampler.lo());
+            return;
+        }
 
-    // Auto-fit (only expands the distance). This prevents the surface from being clipped
-    // when the user pans/rotates, especially when Z-scale is increased.
-    {
-        const float fovYdeg = 45.0f;
-        const float halfFov = 0.5f * fovYdeg * (3.14159265358979323846f / 180.0f);
-        const float z = 0.9f * float(std::max(0.0, zScale_));
-        const float r = std::sqrt(1.0f*1.0f + 1.0f*1.0f + z*z);
-        const float ideal = r / std::sin(halfFov) + 0.6f;
-        if(distance_ < ideal) distance_ = ideal;
-    }
+        const SliceSpec& spec = params->spec;
+        const double xSpan = spec.upper[static_cast<size_t>(spec.xAxis)] - spec.lower[static_cast<size_t>(spec.xAxis)];
+        const double ySpan = spec.upper[static_cast<size_t>(spec.yAxis)] - spec.lower[static_cast<size_t>(spec.yAxis)];
+        // The full-resolution mesh keeps a reference to its grid, and contours come with it;
+        // both read the grid in place.
+        auto build = [&](const std::shared_ptr<const HeightGrid>& grid, int step, double zMin, double zMax){
+            auto mesh = params->heightmap ? buildHeightsCPU(*grid, step, zMin, zMax)
+                                          : buildMeshCPU(*grid, step, zMin, zMax, xSpan, ySpan, params->compact, *cancel);
+            if(!mesh || step!=1) return mesh;
+            if(params->contourLevels>0 && !buildContoursCPU(*mesh, *grid, params->contourLevels, zMin, zMax, *cancel))
+                return decltype(mesh)();
+            mesh->slice = {grid, params->spec};
+            return mesh;
+        };
+
+        // Slopes are sampled for exact normals (heightmap mode computes its normals on the GPU).
+        // Cached grids without them (from the disk store or incremental re-evaluation) are
+        // meshed with triangle normals rather than sampled again.
+        const bool wantSlopes = params->exactNormals && !params->heightmap;
+        const SliceKey key = SliceKey::of(params->obj, params->spec);
+        if(auto cached = sliceCache_.find(key)){
+            auto mesh = build(cached, 1, cached->zMin, cached->zMax);
+            if(!mesh) return;
+            lastKey_ = key;
+            post(mesh, true);
+            boundMinimum(cached.get(), cached->zMax - cached->zMin);
+            return;
+        }
+
+        // Only the fixed value the incremental sampler was prepared for has changed: just the
+        // part of the expression that depends on it is evaluated.
+        if(incremental_ && !incremental_->accepts(params->obj, params->spec)) incremental_.reset();
+        if(incremental_){
+            auto sampled = std::make_shared<HeightGrid>();
+            const double value = params->spec.fixed[static_cast<size_t>(incremental_->variable())];
+            if(!incremental_->sample(value, *sampled, cancel.get())) return;
+            auto mesh = build(sampled, 1, sampled->zMin, sampled->zMax);
+            if(!mesh) return;
+            sliceCache_.insert(key, sampled);
+            lastKey_ = key;
+            post(mesh, true);
+            boundMinimum(sampled.get(), sampled->zMax - sampled->zMin);
+            return;
+        }
+
+        // Coarse-to-fine: every level reuses the samples of the levels before it and is
+        // shown as soon as it is meshed, so the first picture arrives after a few hundred
+        // evaluations whatever the grid size.
+        const GridSampler sampler(params->obj, params->spec);
+        const int N = params->spec.n;
+        QElapsedTimer sampling;
+        sampling.start();
+        auto sampled = std::make_shared<HeightGrid>();
+        HeightGrid& grid = *sampled;
+        grid.n = N;
+        grid.z.assign(static_cast<size_t>(N)*static_cast<size_t>(N), 0.0);
+        if(wantSlopes){
+            grid.dzdx.assign(grid.z.size(), 0.0);
+            grid.dzdy.assign(grid.z.size(), 0.0);
+        }
+
+        double lo = std::numeric_limits<double>::infinity();
+        double hi = -std::numeric_limits<double>::infinity();
+        int prevStep = 0;
+        const std::vector<int> steps = params->previews ? GridSampler::refinementSteps(N) : std::vector<int>{1};
+        for(int step : steps){
+            if(N>=2 && !sampler.sampleLevel(grid, step, prevStep, lo, hi, cancel.get())) return;
+            prevStep = step;
+
+            displayRange(lo, hi, grid.zMin, grid.zMax);
+            auto mesh = build(sampled, step, grid.zMin, grid.zMax);
+            if(!mesh) return;
+            if(step==1) sliceCache_.insert(key, sampled);
+            post(mesh, step==1);
+        }
+        // Slow slices are also kept on disk, once the surface is on its way; cheap ones are
+        // quicker to sample again.
+        if(sampling.elapsed() >= kPersistMs) sliceCache_.persist(key, *sampled);
+
+        // One fixed value was changed: the user is probably nudging it. The parts of the
+        // expression that do not depend on it are sampled now, after the mesh has been posted,
+        // so the next change of that value is cheap.
+        const int changed = changedFixedValue(lastKey_, key);
+        lastKey_ = key;
+        if(changed >= 0){
+            auto incremental = std::make_unique<IncrementalSampler>(params->obj, params->spec, changed);
+            if(incremental->partBytes() <= kMaxIncrementalBytes && incremental->prepare(cancel.get()))
+                incremental_ = std::move(incremental);
+        }
+        boundMinimum(&grid, grid.zMax - grid.zMin);
+    });
+}
+
+void SurfaceWidget::onMeshReady(std::shared_ptr<const MeshSnapshot> mesh, quint64 generation, bool final)
+{
+    // A newer request has been made since this job started; its result will follow.
+    if(generation != generation_) return;
+
+    const double ms = double(rebuildTimer_.nsecsElapsed()) / 1e6;
+    if(firstLevelMs_ < 0.0) firstLevelMs_ = ms;
+
+    mesh_ = std::move(mesh);
+    fitDistance();
 
     if(isValid()){
         makeCurrent();
@@ -56,6 +333,24 @@ void SurfaceWidget::rebuildSurface()
         doneCurrent();
     }
     update();
+
+    if(final){
+        inFlight_ = false;
+        lastRebuildMs_ = ms;
+        emit rebuildFinished(mesh_->n, firstLevelMs_, ms);
+    }
+}
+
+void SurfaceWidget::fitDistance()
+{
+    // Auto-fit (only expands the distance). This prevents the surface from being clipped
+    // when the user pans/rotates, especially when Z-scale is increased.
+    const float fovYdeg = 45.0f;
+    const float halfFov = 0.5f * fovYdeg * (3.14159265358979323846f / 180.0f);
+    const float z = 0.9f * float(std::max(0.0, zScale_));
+    const float r = std::sqrt(1.0f*1.0f + 1.0f*1.0f + z*z);
+    const float ideal = r / std::sin(halfFov) + 0.6f;
+    if(distance_ < ideal) distance_ = ideal;
 }
 
 void SurfaceWidget::initializeGL()
@@ -66,6 +361,15 @@ void SurfaceWidget::initializeGL()
     glEnable(GL_CULL_FACE);
     glCullFace(GL_BACK);
 
+    glGenQueries(kTimerQueries, timerQueries_);
+    timerIssued_ = timerRead_ = 0;
+
+    // Persistent mapping needs glBufferStorage (GL 4.4 / GL_ARB_buffer_storage), which is
+    // not part of the 3.3 core function set.
+    bufferStorage_ = nullptr;
+    if(context()->hasExtension("GL_ARB_buffer_storage"))
+        bufferStorage_ = reinterpret_cast<PFNGLBUFFERSTORAGEPROC>(context()->getProcAddress("glBufferStorage"));
+
     ensureProgram();
     uploadMeshGL();
 }
@@ -85,6 +389,12 @@ QMatrix4x4 SurfaceWidget::projection() const
 {
     QMatrix4x4 p;
     const float aspect = float(width()) / float(std::max(1, height()));
+    if(topView_){
+        // As much of the plane as the perspective camera shows at the focal distance.
+        const float h = distance_ * std::tan(0.5f * 45.0f * (3.14159265358979323846f / 180.0f));
+        p.ortho(-h*aspect, h*aspect, -h, h, 0.01f, 100.0f);
+        return p;
+    }
     p.perspective(45.0f, aspect, 0.01f, 100.0f);
     return p;
 }
@@ -94,6 +404,7 @@ QMatrix4x4 SurfaceWidget::view() const
     QMatrix4x4 v;
     v.translate(pan_);
     v.translate(0.f, 0.f, -distance_);
+    if(topView_) return v;   // looking down the height axis
     v.rotate(pitch_, 1.f, 0.f, 0.f);
     v.rotate(yaw_, 0.f, 1.f, 0.f);
     return v;
@@ -109,22 +420,82 @@ void SurfaceWidget::paintGL()
     glClearColor(0.07f,0.07f,0.09f,1.f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    if(!ensureProgram() || vao_==0 || indices_.empty()){
+    readGpuTimers();
+
+    const bool heights = mesh_ && !mesh_->heights.empty();
+    if(!ensureProgram()) return;
+    if(heights ? (heightTex_==0 || !ensureHeightProgram())
+               : (meshBuffers_[meshFront_].vao==0 || meshN_==0 || (meshCompact_ && !ensureCompactProgram()))){
         return;
     }
 
     if(wireframe_) glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
     else glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
-    prog_->bind();
-
     const QMatrix4x4 mvp = projection() * view();
-    prog_->setUniformValue("u_mvp", mvp);
-    prog_->setUniformValue("u_lightDir", QVector3D(0.35f, 0.8f, 0.5f));
 
-    glBindVertexArray(vao_);
-    glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(indices_.size()), GL_UNSIGNED_INT, nullptr);
-    glBindVertexArray(0);
+    // Contours lie on the bilinear cells rather than on their two triangles; pushing the
+    // surface back keeps them from sinking into it.
+    const bool contours = contourVertices_ > 0;
+    if(contours){
+        glEnable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(1.f, 2.f);
+    }
+
+    // Time only the surface draw; a query is skipped while all of them are still in flight.
+    const bool timed = timerQueries_[0] != 0 && timerIssued_ - timerRead_ < kTimerQueries;
+    if(timed) glBeginQuery(GL_TIME_ELAPSED, timerQueries_[timerIssued_ % kTimerQueries]);
+
+    if(heights){
+        const GridGeometry* geo = gridGeometry(heightN_);
+        heightProg_->bind();
+        heightProg_->setUniformValue("u_mvp", mvp);
+        heightProg_->setUniformValue("u_lightDir", QVector3D(0.35f, 0.8f, 0.5f));
+        heightProg_->setUniformValue("u_zScale", float(zScale_));
+        heightProg_->setUniformValue("u_n", heightN_);
+        heightProg_->setUniformValue("u_stretch", heightStretch_);
+        heightProg_->setUniformValue("u_height", 0);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, heightTex_);
+        drawGrid(geo->vao, heightN_);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        heightProg_->release();
+    } else {
+        QOpenGLShaderProgram* prog = meshCompact_ ? compactProg_ : prog_;
+        prog->bind();
+        prog->setUniformValue("u_mvp", mvp);
+        prog->setUniformValue("u_lightDir", QVector3D(0.35f, 0.8f, 0.5f));
+        prog->setUniformValue("u_zScale", float(zScale_));
+        MeshBuffer& buf = meshBuffers_[meshFront_];
+        if(meshIndexCount_ > 0){
+            glBindVertexArray(buf.vao);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, meshEbo_);
+            glDrawElements(GL_TRIANGLES, meshIndexCount_, GL_UNSIGNED_INT, nullptr);
+            glBindVertexArray(0);
+        } else {
+            drawGrid(buf.vao, meshN_);
+        }
+        if(buf.map){
+            // The next upload into this buffer waits until the GPU is done with this frame.
+            if(buf.fence) glDeleteSync(buf.fence);
+            buf.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
+        prog->release();
+    }
+
+    if(timed){
+        glEndQuery(GL_TIME_ELAPSED);
+        ++timerIssued_;
+    }
+
+    if(contours){
+        glDisable(GL_POLYGON_OFFSET_FILL);
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        drawContours(mvp);
+    }
+
+    prog_->bind();
+    prog_->setUniformValue("u_lightDir", QVector3D(0.35f, 0.8f, 0.5f));
 
     // axes overlay in 3D (simple line draw using the same program and a tiny VAO-free path)
     drawAxes(mvp);
@@ -134,6 +505,20 @@ void SurfaceWidget::paintGL()
     glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 }
 
+void SurfaceWidget::readGpuTimers()
+{
+    while(timerRead_ < timerIssued_){
+        const unsigned int q = timerQueries_[timerRead_ % kTimerQueries];
+        GLint ready = 0;
+        glGetQueryObjectiv(q, GL_QUERY_RESULT_AVAILABLE, &ready);
+        if(!ready) break;
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(q, GL_QUERY_RESULT, &ns);
+        ++timerRead_;
+        emit gpuFrameTimed(double(ns) / 1e6);
+    }
+}
+
 void SurfaceWidget::drawAxes(const QMatrix4x4& mvp)
 {
     // Quick & simple: draw 3 lines via immediate-mode-like upload to a small VBO-less draw.
@@ -169,11 +554,28 @@ void SurfaceWidget::drawAxes(const QMatrix4x4& mvp)
     }
 
     prog_->setUniformValue("u_mvp", mvp);
+    prog_->setUniformValue("u_zScale", 1.0f);
     glBindVertexArray(axVao);
     glDrawArrays(GL_LINES, 0, 6);
     glBindVertexArray(0);
 }
 
+void SurfaceWidget::drawContours(const QMatrix4x4& mvp)
+{
+    if(!ensureContourProgram()) return;
+    // From above the lines must show on steep walls too, where the surface would hide them.
+    if(topView_) glDisable(GL_DEPTH_TEST);
+    contourProg_->bind();
+    contourProg_->setUniformValue("u_mvp", mvp);
+    contourProg_->setUniformValue("u_zScale", float(zScale_));
+    contourProg_->setUniformValue("u_color", topView_ ? QVector3D(0.08f, 0.08f, 0.1f) : QVector3D(0.95f, 0.95f, 0.95f));
+    glBindVertexArray(contourVao_);
+    glDrawArrays(GL_LINES, 0, contourVertices_);
+    glBindVertexArray(0);
+    contourProg_->release();
+    if(topView_) glEnable(GL_DEPTH_TEST);
+}
+
 void SurfaceWidget::mousePressEvent(QMouseEvent* e)
 {
     lastPos_ = e->pos();
@@ -185,7 +587,13 @@ void SurfaceWidget::mouseMoveEvent(QMouseEvent* e)
     const QPoint delta = e->pos() - lastPos_;
     lastPos_ = e->pos();
 
-    if(e->buttons() & Qt::LeftButton){
+    if(topView_ && (e->buttons() & (Qt::LeftButton | Qt::RightButton))){
+        // Nothing to rotate from above; both buttons pan, at the scale of the visible plane.
+        const float perPixel = 2.f * distance_ * std::tan(0.5f * 45.0f * (3.14159265358979323846f / 180.0f))
+                             / float(std::max(1, height()));
+        pan_ += QVector3D(delta.x() * perPixel, -delta.y() * perPixel, 0.f);
+        update();
+    } else if(e->buttons() & Qt::LeftButton){
         yaw_   += delta.x() * 0.35f;
         pitch_ += delta.y() * 0.35f;
         pitch_ = clampf(pitch_, -89.f, 89.f);
@@ -207,6 +615,40 @@ void SurfaceWidget::wheelEvent(QWheelEvent* e)
     e->accept();
 }
 
+static const char* kSurfaceFs = R"(#version 330 core
+in vec3 v_nrm;
+in vec3 v_col;
+
+uniform vec3 u_lightDir;
+out vec4 frag;
+
+void main(){
+    vec3 N = normalize(v_nrm);
+    float diff = max(dot(N, normalize(u_lightDir)), 0.0);
+    float amb = 0.28;
+    vec3 col = v_col * (amb + 0.85*diff);
+    frag = vec4(col, 1.0);
+}
+)";
+
+// perceptual-ish ramp: blue -> green -> yellow, from the normalised height h in [-0.9, 0.9]
+// (the same ramp buildMeshCPU() bakes into the float vertices).
+static const char* kHeightRampGlsl = R"(
+vec3 heightColor(float h){
+    float t = clamp(h/1.8 + 0.5, 0.0, 1.0);
+    return vec3(clamp(1.4*(t-0.5), 0.0, 1.0),
+                clamp(1.2*(1.0-abs(2.0*t-1.0)), 0.0, 1.0),
+                clamp(1.0 - 1.2*t, 0.0, 1.0));
+}
+)";
+
+bool SurfaceWidget::linkSurfaceProgram(QOpenGLShaderProgram* prog, const QByteArray& vs)
+{
+    return prog->addShaderFromSourceCode(QOpenGLShader::Vertex, vs)
+        && prog->addShaderFromSourceCode(QOpenGLShader::Fragment, kSurfaceFs)
+        && prog->link();
+}
+
 bool SurfaceWidget::ensureProgram()
 {
     if(prog_) return true;
@@ -219,201 +661,741 @@ layout(location=1) in vec3 a_nrm;
 layout(location=2) in vec3 a_col;
 
 uniform mat4 u_mvp;
+uniform float u_zScale;
 out vec3 v_nrm;
 out vec3 v_col;
 
 void main(){
-    gl_Position = u_mvp * vec4(a_pos, 1.0);
-    v_nrm = a_nrm;
+    gl_Position = u_mvp * vec4(a_pos.xy, a_pos.z * u_zScale, 1.0);
+    // Scaling z by s scales the x/y components of the (unnormalised) surface normal by s.
+    v_nrm = vec3(a_nrm.xy * u_zScale, a_nrm.z);
     v_col = a_col;
 }
 )";
 
-    const char* fs = R"(#version 330 core
-in vec3 v_nrm;
-in vec3 v_col;
+    return linkSurfaceProgram(prog_, vs);
+}
 
-uniform vec3 u_lightDir;
-out vec4 frag;
+bool SurfaceWidget::ensureCompactProgram()
+{
+    if(compactProg_) return true;
+
+    compactProg_ = new QOpenGLShaderProgram();
+
+    // PackedVertex: the attributes arrive normalised, so a_xy is in [0,1] and a_h, a_oct in [-1,1].
+    const QByteArray vs = QByteArray(R"(#version 330 core
+layout(location=0) in vec2 a_xy;
+layout(location=1) in float a_h;
+layout(location=2) in vec2 a_oct;
+
+uniform mat4 u_mvp;
+uniform float u_zScale;
+out vec3 v_nrm;
+out vec3 v_col;
+)") + kHeightRampGlsl + QByteArray(R"(
+vec3 octDecode(vec2 o){
+    vec3 n = vec3(o, 1.0 - abs(o.x) - abs(o.y));
+    if(n.z < 0.0) n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return n;
+}
 
 void main(){
-    vec3 N = normalize(v_nrm);
-    float diff = max(dot(N, normalize(u_lightDir)), 0.0);
-    float amb = 0.28;
-    vec3 col = v_col * (amb + 0.85*diff);
-    frag = vec4(col, 1.0);
+    float h = a_h * )") + QByteArray::number(kHeightRange, 'f', 3) + QByteArray(R"(;
+    gl_Position = u_mvp * vec4(a_xy*2.0 - 1.0, h * u_zScale, 1.0);
+    vec3 n = octDecode(a_oct);
+    v_nrm = vec3(n.xy * u_zScale, n.z);
+    v_col = heightColor(h);
 }
-)";
+)");
 
-    if(!prog_->addShaderFromSourceCode(QOpenGLShader::Vertex, vs)){
-        return false;
-    }
-    if(!prog_->addShaderFromSourceCode(QOpenGLShader::Fragment, fs)){
-        return false;
-    }
-    if(!prog_->link()){
-        return false;
-    }
-    return true;
+    return linkSurfaceProgram(compactProg_, vs);
 }
 
-void SurfaceWidget::clearGL()
+bool SurfaceWidget::ensureContourProgram()
 {
-    if(vao_){ glDeleteVertexArrays(1, &vao_); vao_=0; }
-    if(vbo_){ glDeleteBuffers(1, &vbo_); vbo_=0; }
-    if(ebo_){ glDeleteBuffers(1, &ebo_); ebo_=0; }
+    if(contourProg_) return true;
 
-    if(prog_){ delete prog_; prog_=nullptr; }
+    contourProg_ = new QOpenGLShaderProgram();
+
+    // Vertices as in MeshSnapshot::contours; the height is scaled like the surface.
+    const char* vs = R"(#version 330 core
+layout(location=0) in vec3 a_pos;
+
+uniform mat4 u_mvp;
+uniform float u_zScale;
+
+void main(){
+    gl_Position = u_mvp * vec4(a_pos.xy, a_pos.z * u_zScale, 1.0);
 }
+)";
+    const char* fs = R"(#version 330 core
+uniform vec3 u_color;
+out vec4 frag;
 
-void SurfaceWidget::buildMeshCPU()
+void main(){
+    frag = vec4(u_color, 1.0);
+}
+)";
+
+    return contourProg_->addShaderFromSourceCode(QOpenGLShader::Vertex, vs)
+        && contourProg_->addShaderFromSourceCode(QOpenGLShader::Fragment, fs)
+        && contourProg_->link();
+}
+
+bool SurfaceWidget::ensureHeightProgram()
 {
-    vertices_.clear();
-    indices_.clear();
-    if(gridN_ < 3) return;
+    if(heightProg_) return true;
 
-    const int N = gridN_;
-    vertices_.resize(static_cast<size_t>(N*N));
-    indices_.reserve(static_cast<size_t>((N-1)*(N-1)*6));
+    heightProg_ = new QOpenGLShaderProgram();
 
-    std::vector<double> x(static_cast<size_t>(dim_), 0.0);
-    if(static_cast<int>(fixed_.size())==dim_) x = fixed_;
-    else x.assign(static_cast<size_t>(dim_), 0.0);
+    // Vertex k of the static grid is texel (k % n, k / n). Heights are normalised as in
+    // buildMeshCPU(); normals come from central differences (one-sided at the border) and
+    // are oriented like the mesh normals, (dz/dx, dz/dy, -1). u_stretch moves a preview's
+    // vertices to their grid positions (see MeshSnapshot).
+    const QByteArray vs = QByteArray(R"(#version 330 core
+layout(location=0) in vec2 a_xy;
 
-    const double loX = lower_[static_cast<size_t>(xAxis_)];
-    const double hiX = upper_[static_cast<size_t>(xAxis_)];
-    const double loY = lower_[static_cast<size_t>(yAxis_)];
-    const double hiY = upper_[static_cast<size_t>(yAxis_)];
+uniform mat4 u_mvp;
+uniform float u_zScale;
+uniform int u_n;
+uniform float u_stretch;
+uniform sampler2D u_height;
+out vec3 v_nrm;
+out vec3 v_col;
+)") + kHeightRampGlsl + QByteArray(R"(
+float height(ivec2 p){
+    return texelFetch(u_height, clamp(p, ivec2(0), ivec2(u_n-1)), 0).r;
+}
 
-    // First pass: evaluate z and find min/max
-    std::vector<double> zs(static_cast<size_t>(N*N), 0.0);
-    double zMin= std::numeric_limits<double>::infinity();
-    double zMax=-std::numeric_limits<double>::infinity();
+vec2 gridPos(ivec2 p){
+    return min(vec2(clamp(p, ivec2(0), ivec2(u_n-1))) * (u_stretch / float(u_n-1)), vec2(1.0));
+}
 
-    for(int j=0;j<N;j++){
-        const double ty = double(j)/(N-1);
-        const double yv = loY + (hiY-loY)*ty;
-        for(int i=0;i<N;i++){
-            const double tx = double(i)/(N-1);
-            const double xv = loX + (hiX-loX)*tx;
+void main(){
+    ivec2 p = ivec2(gl_VertexID % u_n, gl_VertexID / u_n);
+    float h = height(p);
+    gl_Position = u_mvp * vec4(min(a_xy*u_stretch, vec2(1.0))*2.0 - 1.0, h * u_zScale, 1.0);
+
+    float wx = 2.0 * (gridPos(p + ivec2(1,0)).x - gridPos(p - ivec2(1,0)).x);
+    float wy = 2.0 * (gridPos(p + ivec2(0,1)).y - gridPos(p - ivec2(0,1)).y);
+    float dx = (height(p + ivec2(1,0)) - height(p - ivec2(1,0))) / wx;
+    float dy = (height(p + ivec2(0,1)) - height(p - ivec2(0,1))) / wy;
+    v_nrm = vec3(u_zScale*dx, u_zScale*dy, -1.0);
+    v_col = heightColor(h);
+}
+)");
 
-            x[static_cast<size_t>(xAxis_)] = xv;
-            x[static_cast<size_t>(yAxis_)] = yv;
+    return linkSurfaceProgram(heightProg_, vs);
+}
 
-            double z = obj_.evaluate(x);
-            if(!std::isfinite(z)) z = 0.0;
+void SurfaceWidget::clearGL()
+{
+    for(MeshBuffer& buf : meshBuffers_){
+        releaseMeshBuffer(buf);
+        if(buf.vao){ glDeleteVertexArrays(1, &buf.vao); buf.vao=0; }
+    }
+    meshFront_ = 0;
+    meshN_ = 0;
+    if(meshEbo_){ glDeleteBuffers(1, &meshEbo_); meshEbo_=0; }
+    meshIndexCount_ = 0;
+    meshEboCapacity_ = 0;
+
+    for(auto& [n, geo] : gridCache_){
+        glDeleteVertexArrays(1, &geo.vao);
+        glDeleteBuffers(1, &geo.vbo);
+    }
+    gridCache_.clear();
+    for(auto& [key, idx] : indexCache_) glDeleteBuffers(1, &idx.ebo);
+    indexCache_.clear();
+    if(timerQueries_[0]){
+        glDeleteQueries(kTimerQueries, timerQueries_);
+        std::fill(std::begin(timerQueries_), std::end(timerQueries_), 0u);
+    }
+    if(heightTex_){ glDeleteTextures(1, &heightTex_); heightTex_=0; heightN_=0; }
+    if(contourVao_){ glDeleteVertexArrays(1, &contourVao_); contourVao_=0; }
+    if(contourVbo_){ glDeleteBuffers(1, &contourVbo_); contourVbo_=0; }
+    contourCapacity_ = 0;
+    contourVertices_ = 0;
 
-            // tame extremes to keep mesh readable
-            if(std::fabs(z) > 1e12) z = (z>0?1e12:-1e12);
+    if(prog_){ delete prog_; prog_=nullptr; }
+    if(compactProg_){ delete compactProg_; compactProg_=nullptr; }
+    if(heightProg_){ delete heightProg_; heightProg_=nullptr; }
+    if(contourProg_){ delete contourProg_; contourProg_=nullptr; }
+}
 
-            const size_t idx = static_cast<size_t>(j*N+i);
-            zs[idx]=z;
-            if(z<zMin) zMin=z;
-            if(z>zMax) zMax=z;
+template <class Index>
+void SurfaceWidget::fillGridIndices(int N, Index* indices)
+{
+    // Two triangles per cell, (N-1)*(N-1)*6 indices.
+    ThreadPool& pool = ThreadPool::global();
+    pool.parallelFor(N-1, std::max(1, N / (4*pool.concurrency())), [&](int j0, int j1){
+        for(int j=j0;j<j1;j++){
+            Index* out = indices + static_cast<size_t>(j)*static_cast<size_t>(N-1)*6;
+            for(int i=0;i<N-1;i++){
+                const Index i0 = static_cast<Index>(j*N + i);
+                const Index i1 = static_cast<Index>(j*N + (i+1));
+                const Index i2 = static_cast<Index>((j+1)*N + i);
+                const Index i3 = static_cast<Index>((j+1)*N + (i+1));
+                // tri1: i0 i2 i1
+                *out++ = i0; *out++ = i2; *out++ = i1;
+                // tri2: i1 i2 i3
+                *out++ = i1; *out++ = i2; *out++ = i3;
+            }
         }
+    });
+}
+
+// Strips run across bands of kStripCells cells rather than across the whole row: consecutive
+// strips then share kStripCells+1 vertices, few enough to still be in the post-transform
+// vertex cache when the next strip reuses them.
+static constexpr int kStripCells = 16;
+
+size_t SurfaceWidget::gridStripIndexCount(int N)
+{
+    // Per band and row: two indices per vertex column plus the restart index.
+    const int cells = N-1;
+    const int full = cells / kStripCells, rest = cells % kStripCells;
+    size_t perRow = static_cast<size_t>(full) * (2*(kStripCells+1) + 1);
+    if(rest) perRow += static_cast<size_t>(2*(rest+1) + 1);
+    return perRow * static_cast<size_t>(cells);
+}
+
+template <class Index>
+void SurfaceWidget::fillGridStrips(int N, Index* indices)
+{
+    // One strip per band and row, (j,i), (j+1,i) for each vertex column i of the band; even
+    // and odd strip triangles reproduce tri1/tri2 of fillGridIndices() with the same winding.
+    const Index restart = std::numeric_limits<Index>::max();
+    const int cells = N-1;
+    const int bands = (cells + kStripCells - 1) / kStripCells;
+    const size_t bandSize = static_cast<size_t>(2*(kStripCells+1) + 1) * static_cast<size_t>(cells);
+    ThreadPool& pool = ThreadPool::global();
+    pool.parallelFor(bands, 1, [&](int b0, int b1){
+        for(int b=b0;b<b1;b++){
+            const int c0 = b*kStripCells, c1 = std::min(c0 + kStripCells, cells);
+            Index* out = indices + static_cast<size_t>(b)*bandSize;
+            for(int j=0;j<cells;j++){
+                for(int i=c0;i<=c1;i++){
+                    *out++ = static_cast<Index>(j*N + i);
+                    *out++ = static_cast<Index>((j+1)*N + i);
+                }
+                *out++ = restart;
+            }
+        }
+    });
+}
+
+std::shared_ptr<SurfaceWidget::MeshSnapshot> SurfaceWidget::buildHeightsCPU(const HeightGrid& grid, int step,
+                                                                        double zMin, double zMax)
+{
+    // Level-`step` sub-grid, normalised exactly like the mesh heights.
+    auto mesh = std::make_shared<MeshSnapshot>();
+    const int N = GridSampler::levelSize(grid.n, step);
+    mesh->n = N;
+    mesh->stretch = grid.n>1 ? float(N-1)*float(step)/float(grid.n-1) : 1.f;
+    mesh->evaluations = static_cast<size_t>(N)*static_cast<size_t>(N);
+    mesh->zMin = static_cast<float>(zMin);
+    mesh->zMax = static_cast<float>(zMax);
+    if(N < 3) return mesh;
+
+    const double zMid = 0.5*(zMin+zMax);
+    const double zRange = (zMax - zMin);
+    mesh->heights.resize(static_cast<size_t>(N)*static_cast<size_t>(N));
+    for(int j=0;j<N;j++){
+        const double* row = grid.z.data() + static_cast<size_t>(GridSampler::levelIndex(j, grid.n, step))*static_cast<size_t>(grid.n);
+        float* out = mesh->heights.data() + static_cast<size_t>(j)*static_cast<size_t>(N);
+        for(int i=0;i<N;i++) out[i] = float((row[GridSampler::levelIndex(i, grid.n, step)] - zMid) / zRange) * 1.8f;
     }
+    return mesh;
+}
 
-    if(!std::isfinite(zMin) || !std::isfinite(zMax) || zMax==zMin){
-        zMin = 0.0; zMax = 1.0;
+std::shared_ptr<SurfaceWidget::MeshSnapshot> SurfaceWidget::buildMeshCPU(const HeightGrid& grid, int step,
+                                                                     double zMin, double zMax,
+                                                                     double xSpan, double ySpan, bool compact,
+                                                                     const std::atomic<bool>& cancel)
+{
+    // Mesh the level-`step` sub-grid of `grid`; vertices sit at their grid positions, so a
+    // short last cell stays short.
+    auto mesh = std::make_shared<MeshSnapshot>();
+    const int N = GridSampler::levelSize(grid.n, step);
+    auto index = [&](int i){ return GridSampler::levelIndex(i, grid.n, step); };
+    mesh->n = N;
+    mesh->evaluations = static_cast<size_t>(N)*static_cast<size_t>(N);
+    if(N < 3) return mesh;
+
+    std::vector<double> sub;
+    if(step > 1){
+        sub.resize(static_cast<size_t>(N)*static_cast<size_t>(N));
+        for(int j=0;j<N;j++)
+            for(int i=0;i<N;i++)
+                sub[static_cast<size_t>(j*N+i)] = grid.z[static_cast<size_t>(index(j))*static_cast<size_t>(grid.n) + static_cast<size_t>(index(i))];
     }
-    zMin_ = static_cast<float>(zMin);
-    zMax_ = static_cast<float>(zMax);
+    const std::vector<double>& zs = (step > 1) ? sub : grid.z;
+
+    std::vector<Vertex>& vertices = mesh->vertices;
+    vertices.resize(static_cast<size_t>(N*N));
+
+    mesh->zMin = static_cast<float>(zMin);
+    mesh->zMax = static_cast<float>(zMax);
 
     const double zMid = 0.5*(zMin+zMax);
     const double zRange = (zMax - zMin);
 
+    ThreadPool& pool = ThreadPool::global();
+    const int rowGrain = std::max(1, N / (4*pool.concurrency()));
+
     // Build vertex positions & initial colors; normals will be computed later
-    for(int j=0;j<N;j++){
-        const float fy = float(j)/(N-1);
-        const float py = (fy*2.f - 1.f);
-
-        for(int i=0;i<N;i++){
-            const float fx = float(i)/(N-1);
-            const float px = (fx*2.f - 1.f);
-
-            const size_t idx = static_cast<size_t>(j*N+i);
-            const double z0 = zs[idx];
-            float pz = float((z0 - zMid) / zRange); // -0.5..0.5 roughly
-            pz *= float(zScale_) * 1.8f; // emphasize but controllable
-
-            // Color ramp based on normalized height
-            float t = float((z0 - zMin) / (zMax - zMin)); // 0..1
-            t = clampf(t, 0.f, 1.f);
-
-            // perceptual-ish ramp: blue -> green -> yellow
-            float r = clampf(1.4f*(t-0.5f), 0.f, 1.f);
-            float g = clampf(1.2f*(1.f-std::fabs(2.f*t-1.f)), 0.f, 1.f);
-            float b = clampf(1.0f - 1.2f*t, 0.f, 1.f);
-
-            Vertex v;
-            v.px=px; v.py=py; v.pz=pz;
-            v.nx=0; v.ny=0; v.nz=1;
-            v.r=r; v.g=g; v.b=b;
-            vertices_[idx]=v;
+    pool.parallelFor(N, rowGrain, [&](int j0, int j1){
+        for(int j=j0;j<j1;j++){
+            const float fy = float(index(j))/(grid.n-1);
+            const float py = (fy*2.f - 1.f);
+
+            for(int i=0;i<N;i++){
+                const float fx = float(index(i))/(grid.n-1);
+                const float px = (fx*2.f - 1.f);
+
+                const size_t idx = static_cast<size_t>(j*N+i);
+                const double z0 = zs[idx];
+                float pz = float((z0 - zMid) / zRange); // -0.5..0.5 roughly
+                pz *= 1.8f; // emphasize; the Z scale itself is applied in the vertex shader
+
+                Vertex v;
+                v.px=px; v.py=py; v.pz=pz;
+                v.nx=0; v.ny=0; v.nz=1;
+                heightRamp(float((z0 - zMin) / (zMax - zMin)), v.r, v.g, v.b);
+                vertices[idx]=v;
+            }
         }
+    });
+    if(cancel.load()) return nullptr;
+
+    // Normals (at Z scale 1). With slopes, the normal follows from the mesh-space derivatives
+    // of pz: it is (dpz/dpx, dpz/dpy, -1), oriented like the triangle normals below.
+    // Otherwise each vertex gathers the normals of its adjacent triangles. The cells are
+    // visited in row-major order (tri1 before tri2), the same order in which a scatter over
+    // the triangle list would add them, so the sums are bit-identical to that approach.
+    std::vector<Vertex>& V = vertices;
+    const bool slopes = grid.hasSlopes();
+    const double sx = 1.8 / zRange * 0.5*xSpan;
+    const double sy = 1.8 / zRange * 0.5*ySpan;
+    auto triNormal=[](const Vertex& a, const Vertex& b, const Vertex& c)->QVector3D{
+        const QVector3D pa(a.px, a.py, a.pz);
+        const QVector3D pb(b.px, b.py, b.pz);
+        const QVector3D pc(c.px, c.py, c.pz);
+        return QVector3D::crossProduct(pb-pa, pc-pa);
+    };
+    pool.parallelFor(N, rowGrain, [&](int j0, int j1){
+        auto at=[&](int i, int j)->const Vertex&{ return V[static_cast<size_t>(j*N+i)]; };
+        for(int j=j0;j<j1;j++){
+            for(int i=0;i<N;i++){
+                if(slopes){
+                    const size_t at = static_cast<size_t>(index(j))*static_cast<size_t>(grid.n) + static_cast<size_t>(index(i));
+                    const double nx = sx*grid.dzdx[at], ny = sy*grid.dzdy[at];
+                    const double len = std::sqrt(nx*nx + ny*ny + 1.0);
+                    if(std::isfinite(len)){
+                        Vertex& v = V[static_cast<size_t>(j*N+i)];
+                        v.nx = float(nx/len);
+                        v.ny = float(ny/len);
+                        v.nz = float(-1.0/len);
+                        continue;
+                    }
+                }
+                QVector3D n(0,0,0);
+                if(j>0){
+                    if(i>0){
+                        // cell (i-1, j-1): vertex is i3 -> tri2 only
+                        n += triNormal(at(i,j-1), at(i-1,j), at(i,j));
+                    }
+                    if(i<N-1){
+                        // cell (i, j-1): vertex is i2 -> tri1 and tri2
+                        n += triNormal(at(i,j-1), at(i,j), at(i+1,j-1));
+                        n += triNormal(at(i+1,j-1), at(i,j), at(i+1,j));
+                    }
+                }
+                if(j<N-1){
+                    if(i>0){
+                        // cell (i-1, j): vertex is i1 -> tri1 and tri2
+                        n += triNormal(at(i-1,j), at(i-1,j+1), at(i,j));
+                        n += triNormal(at(i,j), at(i-1,j+1), at(i,j+1));
+                    }
+                    if(i<N-1){
+                        // cell (i, j): vertex is i0 -> tri1 only
+                        n += triNormal(at(i,j), at(i,j+1), at(i+1,j));
+                    }
+                }
+                if(n.lengthSquared() < 1e-12f) n = QVector3D(0,0,1);
+                n.normalize();
+                Vertex& v = V[static_cast<size_t>(j*N+i)];
+                v.nx = n.x();
+                v.ny = n.y();
+                v.nz = n.z();
+            }
+        }
+    });
+    if(cancel.load()) return nullptr;
+
+    if(compact){
+        std::vector<PackedVertex>& P = mesh->packed;
+        P.resize(V.size());
+        pool.parallelFor(N, rowGrain, [&](int j0, int j1){
+            for(int j=j0;j<j1;j++){
+                for(int i=0;i<N;i++){
+                    const size_t idx = static_cast<size_t>(j*N+i);
+                    P[idx] = packVertex(V[idx], gridCoord16(index(i), grid.n), gridCoord16(index(j), grid.n));
+                }
+            }
+        });
+        std::vector<Vertex>().swap(V);
     }
 
-    // Indices (two triangles per cell)
-    for(int j=0;j<N-1;j++){
-        for(int i=0;i<N-1;i++){
-            const unsigned int i0 = static_cast<unsigned int>(j*N + i);
-            const unsigned int i1 = static_cast<unsigned int>(j*N + (i+1));
-            const unsigned int i2 = static_cast<unsigned int>((j+1)*N + i);
-            const unsigned int i3 = static_cast<unsigned int>((j+1)*N + (i+1));
-            // tri1: i0 i2 i1
-            indices_.push_back(i0); indices_.push_back(i2); indices_.push_back(i1);
-            // tri2: i1 i2 i3
-            indices_.push_back(i1); indices_.push_back(i2); indices_.push_back(i3);
-        }
+    return mesh;
+}
+
+std::shared_ptr<const SurfaceWidget::MeshSnapshot> SurfaceWidget::buildAdaptiveMeshCPU(const AdaptiveMesh& adaptive, int n,
+                                                                                   std::size_t evaluations,
+                                                                                   double zMin, double zMax, bool compact)
+{
+    // Same positions, heights and colours as buildMeshCPU(); `n` is the nominal grid size.
+    auto mesh = std::make_shared<MeshSnapshot>();
+    mesh->n = n;
+    mesh->evaluations = evaluations;
+    mesh->zMin = static_cast<float>(zMin);
+    mesh->zMax = static_cast<float>(zMax);
+
+    const double zMid = 0.5*(zMin+zMax);
+    const double zRange = (zMax - zMin);
+    const size_t count = adaptive.z.size();
+    std::vector<Vertex> V(count);
+    for(size_t k=0;k<count;k++){
+        Vertex& v = V[k];
+        v.px = float(adaptive.u[k])*2.f - 1.f;
+        v.py = float(adaptive.v[k])*2.f - 1.f;
+        v.pz = float((adaptive.z[k] - zMid) / zRange) * 1.8f;
+        v.nx = 0; v.ny = 0; v.nz = 0;
+        heightRamp(float((adaptive.z[k] - zMin) / (zMax - zMin)), v.r, v.g, v.b);
     }
 
-    // Compute normals by accumulating triangle normals
-    std::vector<QVector3D> acc(vertices_.size(), QVector3D(0,0,0));
-    for(size_t k=0;k<indices_.size();k+=3){
-        const unsigned int a=indices_[k], b=indices_[k+1], c=indices_[k+2];
-        const QVector3D pa(vertices_[a].px, vertices_[a].py, vertices_[a].pz);
-        const QVector3D pb(vertices_[b].px, vertices_[b].py, vertices_[b].pz);
-        const QVector3D pc(vertices_[c].px, vertices_[c].py, vertices_[c].pz);
-        const QVector3D n = QVector3D::crossProduct(pb-pa, pc-pa);
-        acc[a] += n; acc[b] += n; acc[c] += n;
+    // Normals (at Z scale 1): the triangles are irregular, so each one scatters its
+    // area-weighted normal to its three vertices.
+    const std::vector<unsigned int>& I = adaptive.indices;
+    for(size_t t=0;t+2<I.size();t+=3){
+        Vertex& a = V[I[t]];
+        Vertex& b = V[I[t+1]];
+        Vertex& c = V[I[t+2]];
+        const QVector3D pa(a.px, a.py, a.pz);
+        const QVector3D n = QVector3D::crossProduct(QVector3D(b.px, b.py, b.pz) - pa, QVector3D(c.px, c.py, c.pz) - pa);
+        for(Vertex* v : {&a, &b, &c}){ v->nx += n.x(); v->ny += n.y(); v->nz += n.z(); }
     }
-    for(size_t i=0;i<vertices_.size();i++){
-        QVector3D n = acc[i];
+    for(Vertex& v : V){
+        QVector3D n(v.nx, v.ny, v.nz);
         if(n.lengthSquared() < 1e-12f) n = QVector3D(0,0,1);
         n.normalize();
-        vertices_[i].nx = n.x();
-        vertices_[i].ny = n.y();
-        vertices_[i].nz = n.z();
+        v.nx = n.x(); v.ny = n.y(); v.nz = n.z();
+    }
+
+    if(compact){
+        mesh->packed.resize(count);
+        for(size_t k=0;k<count;k++)
+            mesh->packed[k] = packVertex(V[k], static_cast<std::uint16_t>(std::lround(adaptive.u[k]*65535.0)),
+                                         static_cast<std::uint16_t>(std::lround(adaptive.v[k]*65535.0)));
+    } else {
+        mesh->vertices = std::move(V);
     }
+    mesh->indices = I;
+    return mesh;
+}
+
+bool SurfaceWidget::buildContoursCPU(MeshSnapshot& mesh, const HeightGrid& grid, int levels,
+                                     double zMin, double zMax, const std::atomic<bool>& cancel)
+{
+    ContourLines lines = extractContours(grid, contourLevels(zMin, zMax, levels), &cancel);
+    if(cancel.load()) return false;
+
+    // Levels to mesh heights, normalised like the vertices; the segments keep their buffer.
+    const float zMid = float(0.5*(zMin+zMax));
+    const float scale = float(1.8 / (zMax - zMin));
+    for(size_t k=2;k<lines.vertices.size();k+=3) lines.vertices[k] = (lines.vertices[k] - zMid) * scale;
+    mesh.contours = std::move(lines.vertices);
+    return true;
+}
+
+SurfaceWidget::PackedVertex SurfaceWidget::packVertex(const Vertex& v, std::uint16_t x, std::uint16_t y)
+{
+    PackedVertex p;
+    p.x = x;
+    p.y = y;
+    p.h = snorm16(v.pz / kHeightRange);
+    p.pad = 0;
+    octEncode(v.nx, v.ny, v.nz, p.ox, p.oy);
+    return p;
 }
 
 void SurfaceWidget::uploadMeshGL()
 {
-    if(vertices_.empty() || indices_.empty()) return;
+    uploadContoursGL();
+    if(mesh_ && !mesh_->heights.empty()){
+        uploadHeightsGL();
+        return;
+    }
+    meshMemory_ = MemoryStats();
+    meshIndexCount_ = 0;
+    if(!mesh_ || (mesh_->vertices.empty() && mesh_->packed.empty())){
+        meshN_ = 0;
+        return;
+    }
+    const bool compact = !mesh_->packed.empty();
+    const void* data = compact ? static_cast<const void*>(mesh_->packed.data()) : static_cast<const void*>(mesh_->vertices.data());
+    const qint64 stride = compact ? qint64(sizeof(PackedVertex)) : qint64(sizeof(Vertex));
+    const qint64 bytes = qint64(compact ? mesh_->packed.size() : mesh_->vertices.size())*stride;
+
+    const int b = bufferStorage_ ? 1 - meshFront_ : 0;
+    MeshBuffer& buf = meshBuffers_[b];
+    if(buf.vao==0) glGenVertexArrays(1, &buf.vao);
+    glBindVertexArray(buf.vao);
+
+    // The mapped storage may only be written once the frame that drew from it is done. If
+    // the wait times out or fails, the buffer is dropped (the GL frees it once unused) and
+    // fresh storage is allocated below instead of writing under the GPU.
+    if(buf.fence){
+        const GLenum waited = glClientWaitSync(buf.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+        glDeleteSync(buf.fence);
+        buf.fence = nullptr;
+        if(waited!=GL_ALREADY_SIGNALED && waited!=GL_CONDITION_SATISFIED) releaseMeshBuffer(buf);
+    }
 
-    if(vao_==0){
-        glGenVertexArrays(1, &vao_);
-        glGenBuffers(1, &vbo_);
-        glGenBuffers(1, &ebo_);
+    if(bytes > buf.capacity){
+        // The first (coarsest) level of a rebuild reserves room for the full-resolution mesh,
+        // so the finer levels are written into the same storage.
+        releaseMeshBuffer(buf);
+        const qint64 capacity = std::max(bytes, qint64(gridN_)*qint64(gridN_)*stride);
+        glGenBuffers(1, &buf.vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, buf.vbo);
+        if(bufferStorage_){
+            const GLbitfield mapFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            // Dynamic storage keeps glBufferSubData() usable should mapping fail.
+            bufferStorage_(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(capacity), nullptr, mapFlags | GL_DYNAMIC_STORAGE_BIT);
+            buf.map = glMapBufferRange(GL_ARRAY_BUFFER, 0, static_cast<GLsizeiptr>(capacity), mapFlags);
+        } else {
+            glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(capacity), nullptr, GL_DYNAMIC_DRAW);
+        }
+        buf.capacity = capacity;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, buf.vbo);
+    if(buf.map){
+        std::memcpy(buf.map, data, static_cast<size_t>(bytes));
+    } else {
+        glBufferSubData(GL_ARRAY_BUFFER, 0, static_cast<GLsizeiptr>(bytes), data);
+    }
+    meshFront_ = b;
+    meshMemory_.vertexBytes = meshBuffers_[0].capacity + meshBuffers_[1].capacity;
+
+    meshN_ = mesh_->n;
+    meshCompact_ = compact;
+    if(compact){
+        // layout: grid xy, height, octahedral normal (all normalised integers)
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, x));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 1, GL_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, h));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, ox));
+    } else {
+        // layout: position, normal, color
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, px));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, nx));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, r));
     }
 
-    glBindVertexArray(vao_);
+    glBindVertexArray(0);
 
-    glBindBuffer(GL_ARRAY_BUFFER, vbo_);
-    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(vertices_.size()*sizeof(Vertex)),
-                 vertices_.data(), GL_STATIC_DRAW);
+    if(!mesh_->indices.empty()){
+        // Adaptive meshes change topology with every stage; their indices are rewritten in
+        // place while they fit.
+        const qint64 indexBytes = qint64(mesh_->indices.size())*qint64(sizeof(unsigned int));
+        if(meshEbo_==0) glGenBuffers(1, &meshEbo_);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, meshEbo_);
+        if(indexBytes > meshEboCapacity_){
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(indexBytes), mesh_->indices.data(), GL_DYNAMIC_DRAW);
+            meshEboCapacity_ = indexBytes;
+        } else {
+            glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, static_cast<GLsizeiptr>(indexBytes), mesh_->indices.data());
+        }
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        meshIndexCount_ = static_cast<int>(mesh_->indices.size());
+        meshMemory_.indexBytes = meshEboCapacity_;
+        return;
+    }
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo_);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(indices_.size()*sizeof(unsigned int)),
-                 indices_.data(), GL_STATIC_DRAW);
+    // Build (or touch) the index buffer now so the first paint does not pay for it.
+    gridIndices(meshN_);
+}
+
+void SurfaceWidget::releaseMeshBuffer(MeshBuffer& buf)
+{
+    if(buf.fence){ glDeleteSync(buf.fence); buf.fence=nullptr; }
+    if(buf.map){
+        glBindBuffer(GL_ARRAY_BUFFER, buf.vbo);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        buf.map = nullptr;
+    }
+    if(buf.vbo){ glDeleteBuffers(1, &buf.vbo); buf.vbo=0; }
+    buf.capacity = 0;
+}
 
-    // layout: position, normal, color
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, px));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, nx));
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, r));
+const SurfaceWidget::GridGeometry* SurfaceWidget::gridGeometry(int N)
+{
+    auto it = gridCache_.find(N);
+    if(it == gridCache_.end()){
+        // Evict the least recently used grid; progressive rebuilds cycle through a few sizes.
+        if(gridCache_.size() >= kMaxCachedGrids){
+            auto lru = leastRecentlyUsed(gridCache_);
+            glDeleteVertexArrays(1, &lru->second.vao);
+            glDeleteBuffers(1, &lru->second.vbo);
+            gridCache_.erase(lru);
+        }
 
+        // Normalised 16-bit grid coordinates.
+        std::vector<std::uint16_t> xy(static_cast<size_t>(N)*static_cast<size_t>(N)*2);
+        for(int j=0;j<N;j++){
+            for(int i=0;i<N;i++){
+                const size_t k = static_cast<size_t>(j*N+i)*2;
+                xy[k]   = gridCoord16(i, N);
+                xy[k+1] = gridCoord16(j, N);
+            }
+        }
+
+        GridGeometry geo;
+        geo.vertexBytes = qint64(xy.size()*sizeof(std::uint16_t));
+        glGenVertexArrays(1, &geo.vao);
+        glGenBuffers(1, &geo.vbo);
+        glBindVertexArray(geo.vao);
+        glBindBuffer(GL_ARRAY_BUFFER, geo.vbo);
+        glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(geo.vertexBytes), xy.data(), GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_UNSIGNED_SHORT, GL_TRUE, 2*sizeof(std::uint16_t), (void*)0);
+        glBindVertexArray(0);
+
+        it = gridCache_.emplace(N, geo).first;
+    }
+    it->second.lastUse = ++gridUse_;
+    return &it->second;
+}
+
+const SurfaceWidget::GridIndices* SurfaceWidget::gridIndices(int N)
+{
+    auto it = indexCache_.find({N, strips_});
+    if(it == indexCache_.end()){
+        if(indexCache_.size() >= kMaxCachedGrids){
+            auto lru = leastRecentlyUsed(indexCache_);
+            glDeleteBuffers(1, &lru->second.ebo);
+            indexCache_.erase(lru);
+        }
+
+        // 16-bit indices whenever every vertex index stays below the restart value 0xFFFF.
+        GridIndices idx;
+        const bool short16 = N*N <= 0xFFFF;
+        const size_t count = strips_ ? gridStripIndexCount(N) : static_cast<size_t>(N-1)*static_cast<size_t>(N-1)*6;
+        std::vector<std::uint16_t> indices16;
+        std::vector<unsigned int> indices;
+        if(short16){
+            indices16.resize(count);
+            if(strips_) fillGridStrips(N, indices16.data()); else fillGridIndices(N, indices16.data());
+        } else {
+            indices.resize(count);
+            if(strips_) fillGridStrips(N, indices.data()); else fillGridIndices(N, indices.data());
+        }
+        idx.mode = strips_ ? GL_TRIANGLE_STRIP : GL_TRIANGLES;
+        idx.type = short16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        idx.count = static_cast<int>(count);
+        idx.bytes = qint64(count) * (short16 ? 2 : 4);
+
+        // Bound while no VAO is, so the buffer is not attached to any of them; drawGrid()
+        // binds it into the current VAO at draw time.
+        glBindVertexArray(0);
+        glGenBuffers(1, &idx.ebo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, idx.ebo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(idx.bytes),
+                     short16 ? static_cast<const void*>(indices16.data()) : static_cast<const void*>(indices.data()),
+                     GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+        it = indexCache_.emplace(std::make_pair(N, strips_), idx).first;
+    }
+    it->second.lastUse = ++gridUse_;
+    return &it->second;
+}
+
+void SurfaceWidget::drawGrid(unsigned int vao, int N)
+{
+    // vao holds the vertices of an N×N grid; the index buffer is attached at draw time.
+    const GridIndices* idx = gridIndices(N);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, idx->ebo);
+    if(idx->mode == GL_TRIANGLE_STRIP){
+        glEnable(GL_PRIMITIVE_RESTART);
+        glPrimitiveRestartIndex(idx->type == GL_UNSIGNED_SHORT ? 0xFFFFu : 0xFFFFFFFFu);
+    }
+    glDrawElements(idx->mode, static_cast<GLsizei>(idx->count), idx->type, nullptr);
+    glDisable(GL_PRIMITIVE_RESTART);
     glBindVertexArray(0);
 }
+
+void SurfaceWidget::uploadHeightsGL()
+{
+    const int N = mesh_->n;
+    if(heightTex_==0){
+        glGenTextures(1, &heightTex_);
+        glBindTexture(GL_TEXTURE_2D, heightTex_);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    } else {
+        glBindTexture(GL_TEXTURE_2D, heightTex_);
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    if(N == heightN_)
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, N, N, GL_RED, GL_FLOAT, mesh_->heights.data());
+    else
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, N, N, 0, GL_RED, GL_FLOAT, mesh_->heights.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+    heightN_ = N;
+    heightStretch_ = mesh_->stretch;
+
+    // Build (or touch) the grid now so the first paint does not pay for it.
+    gridGeometry(N);
+    gridIndices(N);
+}
+
+void SurfaceWidget::uploadContoursGL()
+{
+    contourVertices_ = 0;
+    if(!mesh_ || mesh_->contours.empty()) return;
+
+    if(contourVao_==0){
+        glGenVertexArrays(1, &contourVao_);
+        glGenBuffers(1, &contourVbo_);
+        glBindVertexArray(contourVao_);
+        glBindBuffer(GL_ARRAY_BUFFER, contourVbo_);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3*sizeof(float), (void*)0);
+        glBindVertexArray(0);
+    }
+
+    // Rewritten in place while the segments fit.
+    const qint64 bytes = qint64(mesh_->contours.size())*qint64(sizeof(float));
+    glBindBuffer(GL_ARRAY_BUFFER, contourVbo_);
+    if(bytes > contourCapacity_){
+        glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(bytes), mesh_->contours.data(), GL_DYNAMIC_DRAW);
+        contourCapacity_ = bytes;
+    } else {
+        glBufferSubData(GL_ARRAY_BUFFER, 0, static_cast<GLsizeiptr>(bytes), mesh_->contours.data());
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    contourVertices_ = static_cast<int>(mesh_->contours.size() / 3);
+}
@@ -2,9 +2,25 @@
 #include <QOpenGLWidget>
 #include <QOpenGLFunctions_3_3_Core>
 #include <QOpenGLShaderProgram>
+#include <QByteArray>
 #include <QMatrix4x4>
 #include <QPoint>
+#include <QThreadPool>
+#include <QElapsedTimer>
 #include "ObjectiveFunction.h"
+#include "GridSampler.h"
+#include "AdaptiveSampler.h"
+#include "SliceCache.h"
+#include "SliceStore.h"
+#include "IncrementalSampler.h"
+#include "SliceMinimizer.h"
+#include "ContourExtractor.h"
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
 #include <vector>
 
 class SurfaceWidget final : public QOpenGLWidget, protected QOpenGLFunctions_3_3_Core
@@ -21,9 +37,82 @@ public:
     void setBounds(const std::vector<double>& lower, const std::vector<double>& upper);
     void setFixed(const std::vector<double>& fixed);
     void setWireframe(bool w);
+    // Z scale is a shader uniform: changing it only needs a repaint, not a rebuild.
     void setZScale(double s);
+    // Heightmap mode: the X/Y grid and index buffer depend only on N and are cached on the
+    // GPU; a rebuild uploads a single R32F height texture, and normals and colours are
+    // computed in the vertex shader. Takes effect on the next rebuild.
+    void setHeightmapMode(bool on);
+    // Compact vertices: 12 bytes per vertex instead of 36 (see PackedVertex). Takes effect
+    // on the next rebuild.
+    void setCompactVertices(bool on);
+    // Index order for the surface: banded triangle strips with primitive restart (default) or
+    // the plain triangle list. Index buffers are cached per N, so switching only repaints.
+    void setStripIndices(bool on);
+    // Adaptive sampling (AdaptiveSampler) instead of the uniform grid: a budget of about a
+    // third of the N×N evaluations, spent where the surface bends most. Takes precedence over
+    // heightmap mode. Takes effect on the next rebuild.
+    void setAdaptiveSampling(bool on);
+    // Exact normals (default): uniform grids are sampled with their slopes (forward-mode
+    // differentiation) and mesh normals are computed from them instead of from the adjacent
+    // triangles. Grids without slopes (from the disk store or incremental re-evaluation)
+    // and points with a non-finite slope keep triangle normals. Takes effect on the next
+    // rebuild.
+    void setExactNormals(bool on);
+    // Isolines (ContourExtractor) at `levels` heights spread over the sampled range, drawn as
+    // lines over the surface; 0 turns them off. Uniform grids only, at full resolution.
+    // Takes effect on the next rebuild.
+    void setContourLevels(int levels);
+    // 2D view: the surface seen straight from above with an orthographic projection, so it
+    // reads as a shaded map under its contours. Dragging pans; the wheel zooms.
+    void setTopView(bool on);
 
+    // Objective evaluations behind the surface currently shown.
+    std::size_t evaluations() const;
+
+    // The uniform grid behind the surface shown (the same buffer the slice cache holds, not a
+    // copy) and the slice it samples; grid is null for previews and adaptive meshes.
+    struct SampledSlice {
+        std::shared_ptr<const HeightGrid> grid;
+        SliceSpec spec;
+    };
+    SampledSlice sampledSlice() const;
+
+    // Uniform grids are kept in an LRU cache (see SliceKey); a rebuild of a slice that is
+    // still cached skips sampling and goes straight to meshing.
+    void setSliceCacheBudget(std::size_t bytes);
+    // Backs the slice cache with an on-disk SliceStore in `directory` (empty: memory only).
+    // Grids that took at least kPersistMs to sample are written to it.
+    void setSliceStore(const std::string& directory, std::uint64_t budgetBytes = SliceStore::kDefaultBudget);
+    SliceCache::Stats sliceCacheStats() const;
+
+    // GPU memory held by the current surface (vertex and index buffers, height texture).
+    struct MemoryStats {
+        qint64 vertexBytes{0};
+        qint64 indexBytes{0};
+        qint64 textureBytes{0};
+    };
+    MemoryStats memoryStats() const;
+
+    // Starts a background rebuild from the current settings. A rebuild that is still running
+    // is cancelled; the new mesh replaces the old one when it is ready. Coarse previews are
+    // shown only if the previous rebuild took longer than kPreviewAfterMs.
     void rebuildSurface();
+    // True from rebuildSurface() until its full-resolution mesh has been shown.
+    bool rebuildInFlight() const { return inFlight_; }
+    // Time since the running rebuild was started (ms).
+    double rebuildElapsedMs() const { return double(rebuildTimer_.nsecsElapsed()) / 1e6; }
+
+signals:
+    // Emitted on the GUI thread once the full-resolution mesh has been uploaded.
+    // firstLevelMs is the time until the coarsest preview was shown.
+    void rebuildFinished(int gridN, double firstLevelMs, double totalMs);
+    // GPU time of the surface draw call of a recent frame (GL_TIME_ELAPSED query).
+    void gpuFrameTimed(double ms);
+    // After each rebuild: lower <= min f over the slice <= upper = f(x, y), proven by interval
+    // branch and bound (SliceMinimizer). converged: the gap is within the search tolerance.
+    // upper is not finite if f has no finite value on the slice.
+    void minimumBounded(double lower, double upper, double x, double y, bool converged);
 
 protected:
     void initializeGL() override;
@@ -35,21 +124,120 @@ protected:
     void wheelEvent(QWheelEvent* e) override;
 
 private:
+    // pz is the normalised height at Z scale 1 and (nx, ny, nz) the matching unit normal;
+    // the vertex shader scales pz by u_zScale and uses (s·nx, s·ny, nz) as the normal.
     struct Vertex {
         float px, py, pz;
         float nx, ny, nz;
         float r, g, b;
     };
 
+    // Compact layout: x/y are the grid position as normalised unsigned shorts, h is pz/kHeightRange
+    // as a normalised short, and (ox, oy) the octahedral encoding of the normal. The colour is
+    // derived from h in the vertex shader.
+    struct PackedVertex {
+        std::uint16_t x, y;
+        std::int16_t h, pad;
+        std::int16_t ox, oy;
+    };
+
+    // Immutable result of one rebuild; shared between the worker and the GUI thread.
+    // Holds either the n×n mesh vertices (float or packed) or, in heightmap mode, only the
+    // n×n normalised heights. Grid index buffers depend only on n and live in indexCache_;
+    // an adaptive mesh carries its own triangles.
+    struct MeshSnapshot {
+        int n{0};
+        std::size_t evaluations{0};
+        float zMin{0.f}, zMax{1.f};
+        // Heightmap previews: (n-1)·step/(N-1); the static grid is scaled by it and clamped,
+        // which shortens the last cell of a level whose step does not divide N-1.
+        float stretch{1.f};
+        std::vector<Vertex> vertices;
+        std::vector<PackedVertex> packed;
+        std::vector<unsigned int> indices;
+        std::vector<float> heights;
+        // Contour segments for GL_LINES: x, y and the normalised height per vertex.
+        std::vector<float> contours;
+        SampledSlice slice;
+    };
+
+    // Everything a rebuild job needs, copied at request time.
+    struct RebuildParams {
+        ObjectiveFunction obj;
+        SliceSpec spec;
+        bool heightmap{false};
+        bool compact{false};
+        bool adaptive{false};
+        bool exactNormals{true};
+        int contourLevels{0};
+        bool previews{true};
+    };
+
+    // Heightmap mode: static X/Y grid vertices for one N.
+    struct GridGeometry {
+        unsigned int vao{0}, vbo{0};
+        qint64 vertexBytes{0};
+        quint64 lastUse{0};
+    };
+
+    // Index buffer of an N×N grid, shared by the mesh and heightmap paths.
+    struct GridIndices {
+        unsigned int ebo{0};
+        unsigned int mode{0};   // GL_TRIANGLES or GL_TRIANGLE_STRIP
+        unsigned int type{0};   // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+        int count{0};
+        qint64 bytes{0};
+        quint64 lastUse{0};
+    };
+
+    // Mesh vertex buffer; map is set when the storage is persistently mapped.
+    struct MeshBuffer {
+        unsigned int vao{0}, vbo{0};
+        qint64 capacity{0};
+        void* map{nullptr};
+        GLsync fence{nullptr};
+    };
+
     void clearGL();
     bool ensureProgram();
-    void buildMeshCPU();
+    bool ensureHeightProgram();
+    bool ensureCompactProgram();
+    bool ensureContourProgram();
+    static bool linkSurfaceProgram(QOpenGLShaderProgram* prog, const QByteArray& vs);
+    template <class Index>
+    static void fillGridIndices(int N, Index* out);
+    template <class Index>
+    static void fillGridStrips(int N, Index* out);
+    static size_t gridStripIndexCount(int N);
+    static std::shared_ptr<MeshSnapshot> buildHeightsCPU(const HeightGrid& grid, int step,
+                                                         double zMin, double zMax);
+    // xSpan/ySpan: extent of the slice axes, to scale the slopes of `grid` (if any).
+    static std::shared_ptr<MeshSnapshot> buildMeshCPU(const HeightGrid& grid, int step,
+                                                      double zMin, double zMax, double xSpan, double ySpan,
+                                                      bool compact, const std::atomic<bool>& cancel);
+    // Fills mesh->contours from the full-resolution grid. False if cancelled.
+    static bool buildContoursCPU(MeshSnapshot& mesh, const HeightGrid& grid, int levels,
+                                 double zMin, double zMax, const std::atomic<bool>& cancel);
+    static std::shared_ptr<const MeshSnapshot> buildAdaptiveMeshCPU(const AdaptiveMesh& adaptive, int n,
+                                                                    std::size_t evaluations,
+                                                                    double zMin, double zMax, bool compact);
+    static PackedVertex packVertex(const Vertex& v, std::uint16_t x, std::uint16_t y);
+    void onMeshReady(std::shared_ptr<const MeshSnapshot> mesh, quint64 generation, bool final);
     void uploadMeshGL();
+    void releaseMeshBuffer(MeshBuffer& buf);
+    void uploadHeightsGL();
+    void uploadContoursGL();
+    const GridGeometry* gridGeometry(int N);
+    const GridIndices* gridIndices(int N);
+    void drawGrid(unsigned int vao, int N);
+    void readGpuTimers();
+    void fitDistance();
 
     QMatrix4x4 projection() const;
     QMatrix4x4 view() const;
 
     void drawAxes(const QMatrix4x4& mvp);
+    void drawContours(const QMatrix4x4& mvp);
 
 private:
     ObjectiveFunction obj_;
@@ -58,18 +246,81 @@ private:
     int yAxis_{1};
     int gridN_{81};
     bool wireframe_{false};
+    bool heightmap_{false};
+    bool compact_{false};
+    bool strips_{true};
+    bool adaptive_{false};
+    bool exactNormals_{true};
+    int contourLevels_{0};
+    bool topView_{false};
     double zScale_{1.0};
 
     std::vector<double> lower_, upper_, fixed_;
 
-    std::vector<Vertex> vertices_;
-    std::vector<unsigned int> indices_;
+    std::shared_ptr<const MeshSnapshot> mesh_;
 
-    float zMin_{0.f}, zMax_{1.f};
+    // Background rebuilds: one job at a time; newer requests cancel older ones.
+    QThreadPool rebuildPool_;
+    std::shared_ptr<std::atomic<bool>> cancel_;
+    quint64 generation_{0};
+    QElapsedTimer rebuildTimer_;
+    double firstLevelMs_{-1.0};
+    double lastRebuildMs_{-1.0};
+    bool inFlight_{false};
+    static constexpr double kPreviewAfterMs = 33.0;
+    SliceCache sliceCache_;   // used by the worker; internally locked
+    static constexpr qint64 kPersistMs = 200;
+
+    // Worker-only state; rebuild jobs run one at a time. lastKey_ is the last slice meshed
+    // at full resolution; incremental_ re-evaluates it when one fixed value changes.
+    SliceKey lastKey_;
+    std::unique_ptr<IncrementalSampler> incremental_;
+    static constexpr std::size_t kMaxIncrementalBytes = std::size_t(256) << 20;
+    // Search budget for minimumBounded(): interval evaluations (about 1-2 µs each for the
+    // presets) and the gap, relative to the sampled height range, at which it stops.
+    static constexpr std::size_t kMinimumBoxes = 20000;
+    static constexpr double kMinimumTolerance = 1e-6;
 
     // GL objects
     QOpenGLShaderProgram* prog_{nullptr};
-    unsigned int vao_{0}, vbo_{0}, ebo_{0};
+    QOpenGLShaderProgram* compactProg_{nullptr};
+    int meshN_{0};
+    bool meshCompact_{false};
+    unsigned int meshEbo_{0};        // adaptive meshes only
+    int meshIndexCount_{0};
+    qint64 meshEboCapacity_{0};
+    MemoryStats meshMemory_;
+
+    // With GL_ARB_buffer_storage both are persistently mapped and used in turn: a rebuild is
+    // copied into the one the last frame did not draw, after waiting on its fence. Otherwise
+    // only meshBuffers_[0] is used, updated in place while the mesh fits.
+    MeshBuffer meshBuffers_[2];
+    int meshFront_{0};
+    PFNGLBUFFERSTORAGEPROC bufferStorage_{nullptr};
+
+    // Heightmap mode
+    QOpenGLShaderProgram* heightProg_{nullptr};
+    unsigned int heightTex_{0};
+    int heightN_{0};
+    float heightStretch_{1.f};
+    std::map<int, GridGeometry> gridCache_;
+    quint64 gridUse_{0};
+    static constexpr std::size_t kMaxCachedGrids = 8;
+
+    // Contours of the current mesh.
+    QOpenGLShaderProgram* contourProg_{nullptr};
+    unsigned int contourVao_{0}, contourVbo_{0};
+    qint64 contourCapacity_{0};
+    int contourVertices_{0};
+
+    // Keyed by (N, strips).
+    std::map<std::pair<int, bool>, GridIndices> indexCache_;
+
+    // GL_TIME_ELAPSED queries in a small ring, read back a few frames later so that paintGL
+    // never waits for the GPU.
+    static constexpr int kTimerQueries = 4;
+    unsigned int timerQueries_[kTimerQueries]{};
+    int timerIssued_{0}, timerRead_{0};
 
     // Camera
     QPoint lastPos_;
@@ -0,0 +1,110 @@
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+
+struct ThreadPool::Job
+{
+    const std::function<void(int, int)>* fn{nullptr};
+    int count{0};
+    int grain{1};
+    int chunks{0};
+    std::atomic<int> next{0};
+
+    std::mutex mutex;
+    std::condition_variable done;
+    int finished{0};
+};
+
+ThreadPool::ThreadPool(int threads)
+{
+    if(threads <= 0) threads = static_cast<int>(std::thread::hardware_concurrency());
+    threads = std::max(1, threads);
+
+    // The caller participates in every loop, so spawn one thread fewer.
+    workers_.reserve(static_cast<size_t>(threads - 1));
+    for(int i=1;i<threads;i++) workers_.emplace_back([this]{ workerLoop(); });
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    for(auto& t : workers_) t.join();
+}
+
+ThreadPool& ThreadPool::global()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+bool ThreadPool::runChunk(Job& job)
+{
+    const int c = job.next.fetch_add(1);
+    if(c >= job.chunks) return false;
+
+    const int begin = c * job.grain;
+    const int end = std::min(job.count, begin + job.grain);
+    (*job.fn)(begin, end);
+
+    std::lock_guard<std::mutex> lk(job.mutex);
+    if(++job.finished == job.chunks) job.done.notify_all();
+    return true;
+}
+
+void ThreadPool::workerLoop()
+{
+    for(;;){
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lk(mutex_);
+            cv_.wait(lk, [&]{ return stop_ || !jobs_.empty(); });
+            if(jobs_.empty()) return;
+            job = jobs_.front();
+        }
+
+        if(!runChunk(*job)){
+            // All chunks handed out: retire the job so the next one becomes visible.
+            std::lock_guard<std::mutex> lk(mutex_);
+            if(!jobs_.empty() && jobs_.front() == job) jobs_.pop_front();
+        }
+    }
+}
+
+void ThreadPool::parallelFor(int count, int grain, const std::function<void(int, int)>& fn)
+{
+    if(count <= 0) return;
+    grain = std::max(1, grain);
+    const int chunks = (count + grain - 1) / grain;
+
+    if(workers_.empty() || chunks == 1){
+        for(int b=0; b<count; b+=grain) fn(b, std::min(count, b + grain));
+        return;
+    }
+
+    auto job = std::make_shared<Job>();
+    job->fn = &fn;
+    job->count = count;
+    job->grain = grain;
+    job->chunks = chunks;
+
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        jobs_.push_back(job);
+    }
+    cv_.notify_all();
+
+    while(runChunk(*job)) {}
+
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        auto it = std::find(jobs_.begin(), jobs_.end(), job);
+        if(it != jobs_.end()) jobs_.erase(it);
+    }
+
+    std::unique_lock<std::mutex> lk(job->mutex);
+    job->done.wait(lk, [&]{ return job->finished == job->chunks; });
+}
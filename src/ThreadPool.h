@@ -0,0 +1,44 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Small fixed-size worker pool for data-parallel loops. Several threads may call
+// parallelFor() concurrently; the calling thread always helps with its own loop, so
+// nested or concurrent calls cannot deadlock.
+class ThreadPool
+{
+public:
+    // threads <= 0 uses std::thread::hardware_concurrency().
+    explicit ThreadPool(int threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Number of threads that execute chunks (workers plus the caller).
+    int concurrency() const { return static_cast<int>(workers_.size()) + 1; }
+
+    // Runs fn(begin, end) over [0, count) in chunks of `grain` items and returns when all
+    // chunks have finished. Chunk boundaries depend only on count and grain.
+    void parallelFor(int count, int grain, const std::function<void(int, int)>& fn);
+
+    // Process-wide pool shared by the sampling, meshing and contouring code.
+    static ThreadPool& global();
+
+private:
+    struct Job;
+
+    void workerLoop();
+    static bool runChunk(Job& job);
+
+    std::vector<std::thread> workers_;
+    std::deque<std::shared_ptr<Job>> jobs_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stop_{false};
+};
@@ -0,0 +1,275 @@
+// fvt3d-cli: headless slice sampler. Evaluates the same grid as the GUI (GridSampler) on
+// all cores and streams it out in binary, a band of rows at a time, so grids far larger
+// than memory can be exported.
+//
+// Output (little-endian):
+//   char[4]  "FVTG"
+//   uint32   version (1)
+//   uint32   n               grid is n×n
+//   uint32   bytes per value (8: float64, 4: float32)
+//   float64  xLo, xHi, yLo, yHi
+//   n*n values, row-major: value j*n + i is f at (x_i, y_j)
+//
+// Values are written as evaluated, without the clamping the GUI applies for display: NaN
+// where f is undefined, ±inf where it overflows (or exceeds the float32 range). Their
+// number is reported on stderr.
+
+#include "GridSampler.h"
+#include "ObjectiveFunction.h"
+#include "Presets.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+namespace {
+
+void usage()
+{
+    std::fprintf(stderr,
+        "usage: fvt3d-cli (--expr EXPR --dim D | --preset NAME) [options]\n"
+        "\n"
+        "  --expr EXPR        expression in x0..x(D-1)\n"
+        "  --dim D            number of variables\n"
+        "  --preset NAME      built-in analytic preset (sets expr, dim and bounds)\n"
+        "  --bounds LO,HI     same bounds for every variable\n"
+        "  --lower V,V,...    per-variable lower bounds\n"
+        "  --upper V,V,...    per-variable upper bounds\n"
+        "  --fixed V,V,...    values of the variables that are not on an axis (default 0)\n"
+        "  --axes I,J         slice variables (default 0,1)\n"
+        "  --n N              grid size, N×N points (default 81)\n"
+        "  --float32          write float32 instead of float64\n"
+        "  -o, --output FILE  output file (default: stdout)\n");
+}
+
+bool parseList(const std::string& s, std::vector<double>& out)
+{
+    out.clear();
+    std::stringstream ss(s);
+    std::string item;
+    while(std::getline(ss, item, ',')){
+        char* end = nullptr;
+        const double v = std::strtod(item.c_str(), &end);
+        if(item.empty() || *end != '\0') return false;
+        out.push_back(v);
+    }
+    return !out.empty();
+}
+
+// Whole decimal integer in [lo, hi].
+bool parseInt(const std::string& s, long lo, long hi, int& out)
+{
+    char* end = nullptr;
+    errno = 0;
+    const long v = std::strtol(s.c_str(), &end, 10);
+    if(s.empty() || *end != '\0' || errno == ERANGE || v < lo || v > hi) return false;
+    out = static_cast<int>(v);
+    return true;
+}
+
+bool parseIntList(const std::string& s, long lo, long hi, std::vector<int>& out)
+{
+    out.clear();
+    std::stringstream ss(s);
+    std::string item;
+    while(std::getline(ss, item, ',')){
+        int v = 0;
+        if(!parseInt(item, lo, hi, v)) return false;
+        out.push_back(v);
+    }
+    return !out.empty();
+}
+
+// A single value is broadcast to all dim variables.
+bool expand(std::vector<double>& v, int dim, const char* what)
+{
+    if(v.size()==1) v.assign(static_cast<size_t>(dim), v[0]);
+    if(static_cast<int>(v.size()) != dim){
+        std::fprintf(stderr, "fvt3d-cli: --%s needs 1 or %d values\n", what, dim);
+        return false;
+    }
+    return true;
+}
+
+template <class T>
+void put(std::vector<char>& buf, T v)
+{
+    const char* p = reinterpret_cast<const char*>(&v);
+    buf.insert(buf.end(), p, p + sizeof v);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    std::string expr, presetName, output;
+    int dim = 0, n = 81;
+    bool f32 = false;
+    std::vector<double> lower, upper, fixed, bounds;
+    std::vector<int> axes{0, 1};
+
+    for(int i=1;i<argc;i++){
+        const std::string a = argv[i];
+        auto value = [&]() -> const char* {
+            if(i+1 >= argc){ std::fprintf(stderr, "fvt3d-cli: %s needs a value\n", a.c_str()); std::exit(2); }
+            return argv[++i];
+        };
+        bool ok = true;
+        if(a=="--expr") expr = value();
+        else if(a=="--dim") ok = parseInt(value(), 1, 1000000, dim);
+        else if(a=="--preset") presetName = value();
+        else if(a=="--bounds") ok = parseList(value(), bounds) && bounds.size()==2;
+        else if(a=="--lower") ok = parseList(value(), lower);
+        else if(a=="--upper") ok = parseList(value(), upper);
+        else if(a=="--fixed") ok = parseList(value(), fixed);
+        else if(a=="--axes") ok = parseIntList(value(), 0, 1000000, axes) && axes.size()==2;
+        else if(a=="--n") ok = parseInt(value(), 2, 1 << 20, n);
+        else if(a=="--float32") f32 = true;
+        else if(a=="-o" || a=="--output") output = value();
+        else if(a=="-h" || a=="--help"){ usage(); return 0; }
+        else { std::fprintf(stderr, "fvt3d-cli: unknown option %s\n", a.c_str()); usage(); return 2; }
+        if(!ok){ std::fprintf(stderr, "fvt3d-cli: invalid value for %s\n", a.c_str()); return 2; }
+    }
+
+    if(!presetName.empty()){
+        const Preset* p = findPreset(presetName);
+        if(!p || p->expr.empty()){
+            std::fprintf(stderr, "fvt3d-cli: %s is not an analytic preset\n", presetName.c_str());
+            return 2;
+        }
+        if(expr.empty()) expr = p->expr;
+        if(dim<=0) dim = p->dim;
+        if(bounds.empty() && lower.empty() && upper.empty()) bounds = {p->lo, p->hi};
+    }
+    if(expr.empty() || dim<=0){ usage(); return 2; }
+    if(n<2){ std::fprintf(stderr, "fvt3d-cli: --n must be >= 2\n"); return 2; }
+
+    if(!bounds.empty()){
+        if(lower.empty()) lower = {bounds[0]};
+        if(upper.empty()) upper = {bounds[1]};
+    }
+    if(lower.empty()) lower = {-5.0};
+    if(upper.empty()) upper = {5.0};
+    if(fixed.empty()) fixed = {0.0};
+    if(!expand(lower, dim, "lower") || !expand(upper, dim, "upper") || !expand(fixed, dim, "fixed")) return 2;
+    for(int k=0;k<dim;k++){
+        if(upper[static_cast<size_t>(k)] <= lower[static_cast<size_t>(k)]){
+            std::fprintf(stderr, "fvt3d-cli: x%d: upper must be > lower\n", k);
+            return 2;
+        }
+    }
+
+    const int xAxis = axes[0], yAxis = axes[1];
+    if(xAxis>=dim || yAxis>=dim || xAxis==yAxis){
+        std::fprintf(stderr, "fvt3d-cli: --axes must be two different variables in 0..%d\n", dim-1);
+        return 2;
+    }
+
+    ObjectiveFunction obj;
+    std::string err;
+    if(!obj.setExpression(expr, dim, &err)){
+        std::fprintf(stderr, "fvt3d-cli: %s\n", err.c_str());
+        return 1;
+    }
+
+    SliceSpec spec;
+    spec.dim = dim;
+    spec.xAxis = xAxis;
+    spec.yAxis = yAxis;
+    spec.n = n;
+    spec.lower = lower;
+    spec.upper = upper;
+    spec.fixed = fixed;
+    const GridSampler sampler(obj, spec, true);
+
+    std::FILE* out = stdout;
+    if(!output.empty() && output!="-"){
+        out = std::fopen(output.c_str(), "wb");
+        if(!out){ std::fprintf(stderr, "fvt3d-cli: cannot open %s\n", output.c_str()); return 1; }
+    } else {
+#if defined(_WIN32)
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    }
+
+    std::vector<char> header;
+    header.insert(header.end(), {'F', 'V', 'T', 'G'});
+    put<std::uint32_t>(header, 1);
+    put<std::uint32_t>(header, static_cast<std::uint32_t>(n));
+    put<std::uint32_t>(header, f32 ? 4u : 8u);
+    put<double>(header, lower[static_cast<size_t>(xAxis)]);
+    put<double>(header, upper[static_cast<size_t>(xAxis)]);
+    put<double>(header, lower[static_cast<size_t>(yAxis)]);
+    put<double>(header, upper[static_cast<size_t>(yAxis)]);
+    bool ok = std::fwrite(header.data(), 1, header.size(), out) == header.size();
+
+    // Bands of about 4M values; the previous band is written while the next is sampled.
+    const int bandRows = std::max(1, (1 << 22) / n);
+    const size_t rowLen = static_cast<size_t>(n);
+    ThreadPool& pool = ThreadPool::global();
+    std::vector<double> bands[2];
+    std::vector<float> narrow[2];
+    std::future<bool> pending;
+    double lo = std::numeric_limits<double>::infinity();
+    double hi = -std::numeric_limits<double>::infinity();
+    std::uint64_t nonFinite = 0;
+
+    const auto t0 = std::chrono::steady_clock::now();
+    for(int r0=0, b=0; r0<n && ok; r0+=bandRows, b^=1){
+        const int rows = std::min(bandRows, n - r0);
+        std::vector<double>& band = bands[b];
+        band.resize(static_cast<size_t>(rows) * rowLen);
+
+        const int grain = std::max(1, rows / (4*pool.concurrency()));
+        pool.parallelFor(rows, grain, [&](int a, int e){
+            sampler.sampleRows(r0 + a, r0 + e, band.data() + static_cast<size_t>(a)*rowLen);
+        });
+        for(double z : band){
+            if(!std::isfinite(z)){ nonFinite++; continue; }
+            lo = std::min(lo, z);
+            hi = std::max(hi, z);
+        }
+
+        if(pending.valid()) ok = pending.get();
+        if(f32){
+            narrow[b].assign(band.begin(), band.end());
+            for(size_t k=0;k<band.size();k++) if(std::isfinite(band[k]) && !std::isfinite(narrow[b][k])) nonFinite++;
+        }
+        pending = std::async(std::launch::async, [&, b]{
+            const void* data = f32 ? static_cast<const void*>(narrow[b].data()) : static_cast<const void*>(bands[b].data());
+            const size_t count = bands[b].size();
+            return std::fwrite(data, f32 ? 4 : 8, count, out) == count;
+        });
+    }
+    if(pending.valid()) ok = pending.get() && ok;
+    ok = std::fflush(out)==0 && ok;
+    if(out != stdout) ok = std::fclose(out)==0 && ok;
+    const double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    if(!ok){
+        std::fprintf(stderr, "fvt3d-cli: write failed\n");
+        return 1;
+    }
+    std::fprintf(stderr, "fvt3d-cli: %d×%d grid in %.3f s (%.1f Mpt/s, %d threads), finite z in [%g, %g]\n",
+                 n, n, sec, double(n)*double(n)/sec*1e-6, pool.concurrency(), lo, hi);
+    if(nonFinite > 0){
+        std::fprintf(stderr, "fvt3d-cli: warning: %llu values are not finite (written as NaN or ±inf)%s\n",
+                     static_cast<unsigned long long>(nonFinite), f32 ? ", including float32 overflows" : "");
+    }
+    return 0;
+}